@@ -1,44 +1,47 @@
 #include "../nonstd.hpp"
 #include "core.hpp"
 
+#include <chrono>
+#include <cmath>
+#include <utility>
+
 // Swayfire
 
 bool Swayfire::on_toggle_split_direction(const wf::activator_data_t &) {
-    if (auto parent = get_current_workspace()
-                          ->get_active_node()
-                          ->parent->as_split_node()) {
-
-        if (parent->is_split())
-            parent->set_split_type(
-                (parent->get_split_type() == SplitType::HSPLIT)
-                    ? SplitType::VSPLIT
-                    : SplitType::HSPLIT);
-        else
-            parent->set_split_type(parent->was_vsplit ? SplitType::VSPLIT
-                                                      : SplitType::HSPLIT);
-
-        return true;
-    }
+    auto ws = get_current_workspace();
+    if (auto parent = ws->get_active_node()->parent->as_split_node())
+        return record_layout_change(ws, [&]() {
+            if (parent->is_split())
+                parent->set_split_type(
+                    (parent->get_split_type() == SplitType::HSPLIT)
+                        ? SplitType::VSPLIT
+                        : SplitType::HSPLIT);
+            else
+                parent->set_split_type(parent->was_vsplit
+                                           ? SplitType::VSPLIT
+                                           : SplitType::HSPLIT);
+            return true;
+        });
     return false;
 }
 
 bool Swayfire::on_set_tabbed(const wf::activator_data_t &) {
-    if (auto parent = get_current_workspace()
-                          ->get_active_node()
-                          ->parent->as_split_node()) {
-        parent->set_split_type(SplitType::TABBED);
-        return true;
-    }
+    auto ws = get_current_workspace();
+    if (auto parent = ws->get_active_node()->parent->as_split_node())
+        return record_layout_change(ws, [&]() {
+            parent->set_split_type(SplitType::TABBED);
+            return true;
+        });
     return false;
 }
 
 bool Swayfire::on_set_stacked(const wf::activator_data_t &) {
-    if (auto parent = get_current_workspace()
-                          ->get_active_node()
-                          ->parent->as_split_node()) {
-        parent->set_split_type(SplitType::STACKED);
-        return true;
-    }
+    auto ws = get_current_workspace();
+    if (auto parent = ws->get_active_node()->parent->as_split_node())
+        return record_layout_change(ws, [&]() {
+            parent->set_split_type(SplitType::STACKED);
+            return true;
+        });
     return false;
 }
 
@@ -60,29 +63,105 @@ bool Swayfire::on_set_want_hsplit(const wf::activator_data_t &) {
     return false;
 }
 
-bool Swayfire::focus_direction(Direction dir) {
-    auto active = get_current_workspace()->get_active_node();
-    if (auto adj = active->parent->get_adjacent(active, dir)) {
+/// Get the node reached by hopping from node in dir, node itself if none.
+static Node find_directional_target(Node node, Direction dir) {
+    if (auto adj = node->parent->get_adjacent(node, dir)) {
         if (auto split = adj->as_split_node())
-            adj = split->get_last_active_node();
+            return split->get_last_active_node();
+        return adj;
+    }
+    return node;
+}
 
-        adj->set_active();
-        return true;
+bool Swayfire::queue_directional(DirectionalCommand command) {
+    auto ws = get_current_workspace();
+
+    if (command.move) {
+        // Moves apply to the node the previous commands focused.
+        apply_directional_focus();
+        if (directional_batch && directional_batch.get() != ws.get())
+            flush_directional();
+
+        if (!directional_batch) {
+            directional_before = ws->capture_layout();
+            directional_batch = ws;
+            ws->begin_layout_batch();
+        }
+
+        const bool moved = ws->get_active_node()->move(command.dir);
+        if (!moved && !directional_scheduled) {
+            // Nothing waits for the frame: close the batch right away.
+            directional_batch = nullptr;
+            directional_before.reset();
+            ws->end_layout_batch();
+            return false;
+        }
+
+        schedule_directional();
+        return moved;
+    }
+
+    // Hop from the node the previous commands focused, without activating
+    // the nodes on the way.
+    Node from = directional_focus ? find_node(*directional_focus) : nullptr;
+    if (!from || from->get_ws().get() != ws.get())
+        from = ws->get_active_node();
+
+    const auto target = find_directional_target(from, command.dir);
+    if (target.get() == from.get())
+        return false;
+
+    directional_focus = target->get_id();
+    schedule_directional();
+    return true;
+}
+
+void Swayfire::schedule_directional() {
+    if (directional_scheduled)
+        return;
+
+    directional_scheduled = true;
+    output->render->add_effect(&on_directional_frame, wf::OUTPUT_EFFECT_PRE);
+    output->render->schedule_redraw();
+}
+
+void Swayfire::apply_directional_focus() {
+    if (!directional_focus)
+        return;
+
+    const auto target = find_node(*std::exchange(directional_focus, {}));
+    if (target && target->get_ws().get() == get_current_workspace().get())
+        target->set_active();
+}
+
+void Swayfire::flush_directional() {
+    if (!directional_scheduled)
+        return;
+
+    directional_scheduled = false;
+    output->render->rem_effect(&on_directional_frame);
+
+    apply_directional_focus();
+
+    if (directional_batch) {
+        const auto ws = std::exchange(directional_batch, nullptr);
+        ws->end_layout_batch();
+        record_layout(std::move(*directional_before));
+        directional_before.reset();
     }
-    return false;
 }
 
 bool Swayfire::on_focus_left(const wf::activator_data_t &) {
-    return focus_direction(Direction::LEFT);
+    return queue_directional({false, Direction::LEFT});
 }
 bool Swayfire::on_focus_right(const wf::activator_data_t &) {
-    return focus_direction(Direction::RIGHT);
+    return queue_directional({false, Direction::RIGHT});
 }
 bool Swayfire::on_focus_down(const wf::activator_data_t &) {
-    return focus_direction(Direction::DOWN);
+    return queue_directional({false, Direction::DOWN});
 }
 bool Swayfire::on_focus_up(const wf::activator_data_t &) {
-    return focus_direction(Direction::UP);
+    return queue_directional({false, Direction::UP});
 }
 
 bool focus_tiled(WorkspaceRef ws) {
@@ -114,21 +193,244 @@ bool Swayfire::on_toggle_focus_tile(const wf::activator_data_t &) {
     return is_floating ? focus_tiled(ws) : focus_floating(ws);
 }
 
-bool Swayfire::move_direction(Direction dir) {
-    return get_current_workspace()->get_active_node()->move(dir);
+bool Swayfire::focus_history(bool back) {
+    const auto active = get_current_workspace()->get_active_node();
+
+    // Continue the current cycle if focus didn't move away from it.
+    auto from = mru.cursor && mru.cursor.get() == active.get() ? mru.cursor
+                                                               : mru.front();
+    if (!from)
+        return false;
+
+    auto target = back ? mru.next(from) : mru.prev(from);
+    if (!target)
+        target = back ? mru.front() : mru.back();
+    if (target.get() == active.get())
+        return false;
+
+    mru.cursor = target;
+    mru_cycling = true;
+
+    auto ws = target->get_ws();
+    if (ws.get() != get_current_workspace().get())
+        output->workspace->request_workspace(ws->wsid);
+    target->set_active();
+
+    mru_cycling = false;
+    return true;
 }
 
-bool Swayfire::on_move_left(const wf::activator_data_t &) {
-    return move_direction(Direction::LEFT);
+bool Swayfire::on_focus_back(const wf::activator_data_t &) {
+    return focus_history(true);
 }
-bool Swayfire::on_move_right(const wf::activator_data_t &) {
-    return move_direction(Direction::RIGHT);
+bool Swayfire::on_focus_forward(const wf::activator_data_t &) {
+    return focus_history(false);
 }
-bool Swayfire::on_move_down(const wf::activator_data_t &) {
-    return move_direction(Direction::DOWN);
+
+/// Translate the recorded geometries of a subtree without any side effect.
+///
+/// If stretch, the views are then moved to their new geometries by their geo
+/// enforcer only, and the splits notify their geometry change so that their
+/// decorations follow.
+static void translate_subtree(Node root, wf::point_t delta, bool stretch) {
+    if (delta.x == 0 && delta.y == 0)
+        return;
+
+    root->for_each_node([&](Node node) {
+        const auto old_geo = node->get_geometry();
+        auto geo = old_geo;
+        geo.x += delta.x;
+        geo.y += delta.y;
+
+        node->ref_pure_set_geo();
+        node->set_geometry(geo);
+        node->unref_pure_set_geo();
+
+        if (!stretch)
+            return;
+
+        if (auto vnode = node->as_view_node()) {
+            vnode->geo_enforcer->update_transformer();
+        } else {
+            GeometryChangedSignalData data;
+            data.old_geo = old_geo;
+            data.new_geo = geo;
+            node->emit(&data);
+        }
+    });
 }
-bool Swayfire::on_move_up(const wf::activator_data_t &) {
-    return move_direction(Direction::UP);
+
+/// Get the unit vector of a direction.
+static wf::point_t direction_vector(Direction dir) {
+    switch (dir) {
+    case Direction::LEFT:
+        return {-1, 0};
+    case Direction::RIGHT:
+        return {1, 0};
+    case Direction::UP:
+        return {0, -1};
+    case Direction::DOWN:
+        return {0, 1};
+    }
+    return {0, 0};
+}
+
+Node Swayfire::find_node(uint id) {
+    Node found = nullptr;
+    const auto find = [&](Node node) {
+        if (node->get_id() == id)
+            found = node;
+    };
+
+    workspaces.for_each([&](WorkspaceRef ws) { ws->for_each_node(find); });
+    for (const auto &node : sticky.get_nodes())
+        node->for_each_node(find);
+
+    return found;
+}
+
+bool Swayfire::start_floating_motion(Direction dir,
+                                     const wf::activator_data_t &data) {
+    if (data.source != wf::activator_source_t::KEYBINDING)
+        return false;
+
+    const auto node =
+        get_current_workspace()->get_active_node()->find_floating_parent();
+    if (!node)
+        return false;
+
+    if (floating_motion && floating_motion->node.get() != node.get())
+        stop_floating_motion();
+
+    if (!floating_motion) {
+        const auto geo = node->get_geometry();
+        floating_motion = FloatingMotion{
+            node->get_id(),
+            node,
+            {},
+            (double)std::max(1, (int)floating_move_speed),
+            (double)geo.x,
+            (double)geo.y,
+            {geo.x, geo.y},
+            std::chrono::steady_clock::now(),
+        };
+
+        output->render->add_effect(&on_floating_motion_frame,
+                                   wf::OUTPUT_EFFECT_PRE);
+        wf::get_core().connect(&on_floating_motion_key);
+    }
+
+    auto &motion = *floating_motion;
+
+    // Key repeats of a held key change nothing. A new key nudges the node
+    // right away so that taps still move it.
+    if (motion.keys.emplace(data.activation_data, dir).second) {
+        const auto v = direction_vector(dir);
+        motion.x += v.x * (double)FLOATING_MOVE_STEP;
+        motion.y += v.y * (double)FLOATING_MOVE_STEP;
+    }
+
+    output->render->schedule_redraw();
+    return true;
+}
+
+void Swayfire::step_floating_motion() {
+    if (!floating_motion)
+        return;
+
+    auto &motion = *floating_motion;
+
+    // The node lost focus, maybe because it was destroyed.
+    const auto active =
+        get_current_workspace()->get_active_node()->find_floating_parent();
+    if (!active || active.get() != motion.node.get() ||
+        active->get_id() != motion.node_id) {
+        stop_floating_motion();
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const double dt =
+        std::chrono::duration<double>(now - motion.last_step).count();
+    motion.last_step = now;
+
+    double dx = 0;
+    double dy = 0;
+    for (const auto &[key, dir] : motion.keys) {
+        const auto v = direction_vector(dir);
+        dx += v.x;
+        dy += v.y;
+    }
+
+    // Diagonal moves go as fast as straight ones.
+    if (const double norm = std::hypot(dx, dy); norm > 0) {
+        motion.x += dx / norm * motion.speed * dt;
+        motion.y += dy / norm * motion.speed * dt;
+    }
+
+    motion.speed =
+        std::min(FLOATING_MOVE_MAX_SPEED,
+                 motion.speed +
+                     (double)std::max(0, (int)floating_move_acceleration) * dt);
+
+    const auto geo = motion.node->get_geometry();
+    translate_subtree(motion.node,
+                      {(int)std::lround(motion.x) - geo.x,
+                       (int)std::lround(motion.y) - geo.y},
+                      true);
+
+    output->render->schedule_redraw();
+}
+
+void Swayfire::release_floating_motion_key(std::uint32_t key) {
+    if (!floating_motion)
+        return;
+
+    floating_motion->keys.erase(key);
+    if (floating_motion->keys.empty())
+        stop_floating_motion();
+}
+
+void Swayfire::stop_floating_motion() {
+    if (!floating_motion)
+        return;
+
+    const auto motion = std::move(*floating_motion);
+    floating_motion = std::nullopt;
+
+    wf::get_core().disconnect(&on_floating_motion_key);
+    output->render->rem_effect(&on_floating_motion_frame);
+
+    const auto node = find_node(motion.node_id);
+    if (!node || !node->get_floating())
+        return;
+
+    // Apply the final position for real, from the geometry the motion
+    // started at, so that everything following the node sees a change. The
+    // clients only get moved.
+    auto geo = node->get_geometry();
+    translate_subtree(node, {motion.start.x - geo.x, motion.start.y - geo.y},
+                      false);
+    geo.x = (int)std::lround(motion.x);
+    geo.y = (int)std::lround(motion.y);
+    node->set_geometry(geo);
+}
+
+bool Swayfire::on_move_left(const wf::activator_data_t &data) {
+    return start_floating_motion(Direction::LEFT, data) ||
+           queue_directional({true, Direction::LEFT});
+}
+bool Swayfire::on_move_right(const wf::activator_data_t &data) {
+    return start_floating_motion(Direction::RIGHT, data) ||
+           queue_directional({true, Direction::RIGHT});
+}
+bool Swayfire::on_move_down(const wf::activator_data_t &data) {
+    return start_floating_motion(Direction::DOWN, data) ||
+           queue_directional({true, Direction::DOWN});
+}
+bool Swayfire::on_move_up(const wf::activator_data_t &data) {
+    return start_floating_motion(Direction::UP, data) ||
+           queue_directional({true, Direction::UP});
 }
 
 bool Swayfire::on_toggle_tile(const wf::activator_data_t &) {
@@ -136,14 +438,40 @@ bool Swayfire::on_toggle_tile(const wf::activator_data_t &) {
     auto const node = ws->get_active_node();
 
     // If we're floating, we want to tile.
-    node->tile_request(node->get_floating());
+    return record_layout_change(ws, [&]() {
+        node->tile_request(node->get_floating());
+        return true;
+    });
+}
+
+bool Swayfire::on_dump_recorder(const wf::activator_data_t &) {
+    if (!recorder::dump()) {
+        LOGE("Failed to dump the flight recorder to ",
+             recorder::get_dump_path());
+        return false;
+    }
+
+    LOGI("Flight recorder dumped to ", recorder::get_dump_path());
     return true;
 }
 
 void Swayfire::bind_activators() {
     using namespace std::placeholders;
 
+// Other commands must see the directional commands received before them
+// applied.
 #define BIND_ACTIVATOR(BIND)                                                   \
+    {                                                                          \
+        auto cb = std::make_unique<wf::activator_callback>([&](auto b) {       \
+            flush_directional();                                               \
+            stop_floating_motion();                                            \
+            return on_##BIND(b);                                               \
+        });                                                                    \
+        output->add_activator(key_##BIND, cb.get());                           \
+        activator_callbacks.push_back(std::move(cb));                          \
+    }
+
+#define BIND_QUEUED_ACTIVATOR(BIND)                                            \
     {                                                                          \
         auto cb = std::make_unique<wf::activator_callback>(                    \
             [&](auto b) { return on_##BIND(b); });                             \
@@ -158,23 +486,35 @@ void Swayfire::bind_activators() {
     BIND_ACTIVATOR(set_want_vsplit);
     BIND_ACTIVATOR(set_want_hsplit);
 
-    BIND_ACTIVATOR(focus_left);
-    BIND_ACTIVATOR(focus_right);
-    BIND_ACTIVATOR(focus_down);
-    BIND_ACTIVATOR(focus_up);
+    BIND_QUEUED_ACTIVATOR(focus_left);
+    BIND_QUEUED_ACTIVATOR(focus_right);
+    BIND_QUEUED_ACTIVATOR(focus_down);
+    BIND_QUEUED_ACTIVATOR(focus_up);
 
     BIND_ACTIVATOR(toggle_focus_tile);
 
-    BIND_ACTIVATOR(move_left);
-    BIND_ACTIVATOR(move_right);
-    BIND_ACTIVATOR(move_down);
-    BIND_ACTIVATOR(move_up);
+    BIND_ACTIVATOR(focus_back);
+    BIND_ACTIVATOR(focus_forward);
+
+    BIND_QUEUED_ACTIVATOR(move_left);
+    BIND_QUEUED_ACTIVATOR(move_right);
+    BIND_QUEUED_ACTIVATOR(move_down);
+    BIND_QUEUED_ACTIVATOR(move_up);
 
     BIND_ACTIVATOR(toggle_tile);
+
+    BIND_ACTIVATOR(undo);
+    BIND_ACTIVATOR(redo);
+
+    BIND_ACTIVATOR(dump_recorder);
+#undef BIND_QUEUED_ACTIVATOR
 #undef BIND_ACTIVATOR
 }
 
 void Swayfire::unbind_activators() {
+    flush_directional();
+    stop_floating_motion();
+
     for (auto &cb : activator_callbacks | nonstd::reverse)
         output->rem_binding(cb.get());
     activator_callbacks.clear();
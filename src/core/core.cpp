@@ -2,6 +2,11 @@
 #include "../nonstd.hpp"
 #include "grab.hpp"
 #include "plugin.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <wayfire/config.h>
+#include <wayfire/nonstd/wlroots-full.hpp>
 #include <wayfire/scene-operations.hpp>
 
 // nonwf
@@ -82,6 +87,20 @@ void INode::emit_title_changed() {
     parent->notify_child_title_changed(this);
 }
 
+void INode::add_urgent_count(std::int32_t delta) {
+    if (delta == 0)
+        return;
+
+    assert(delta > 0 || urgent_count >= (std::uint32_t)-delta);
+    urgent_count += delta;
+
+    UrgencyChangedSignal sig;
+    emit(&sig);
+
+    if (parent)
+        parent->notify_child_urgency_changed(this, delta);
+}
+
 SplitNodeRef INode::as_split_node() { return dynamic_cast<SplitNode *>(this); }
 
 ViewNodeRef INode::as_view_node() { return dynamic_cast<ViewNode *>(this); }
@@ -95,8 +114,19 @@ void INode::notify_initialized() {
     on_initialized();
 }
 
+void INode::update_constraints() {
+    const auto ncons = compute_constraints();
+    if (ncons == constraints)
+        return;
+
+    constraints = ncons;
+    if (parent)
+        parent->notify_child_constraints_changed(this);
+}
+
 void INode::add_padding(Padding padding) {
     this->padding += padding;
+    update_constraints();
     PaddingChangedSignal sig = {};
     emit(&sig);
 }
@@ -113,15 +143,43 @@ void INode::add_subsurface(wayfire_view subsurf) {
     wf::scene::remove_child(subsurf->get_root_node());
     wf::scene::add_front(*sublayer, subsurf->get_root_node());
 
+    if (hidden)
+        wf::scene::set_node_enabled(subsurf->get_root_node(), false);
+
     subsurfaces.push_back(subsurf);
 }
 
 void INode::remove_subsurface(wayfire_view subsurf) {
     const auto ss = std::find(subsurfaces.begin(), subsurfaces.end(), subsurf);
     assert(ss != subsurfaces.end());
+
+    if (hidden)
+        wf::scene::set_node_enabled(subsurf->get_root_node(), true);
+
     subsurfaces.erase(ss);
 }
 
+void INode::set_hidden(bool h) {
+    if (h == hidden)
+        return;
+
+    hidden = h;
+    for (auto &subsurf : subsurfaces)
+        wf::scene::set_node_enabled(subsurf->get_root_node(), !hidden);
+
+    on_set_hidden();
+}
+
+void INode::set_ws(WorkspaceRef ws) {
+    assert(ws);
+    if (this->ws.get() == ws.get())
+        return;
+
+    this->ws = ws;
+    WorkspaceChangedSignal sig = {};
+    emit(&sig);
+}
+
 void INode::set_floating(bool fl) {
     if (!floating && fl)
         set_geometry(floating_geometry);
@@ -207,6 +265,7 @@ ViewGeoEnforcer::ViewGeoEnforcer(ViewNodeRef node)
 }
 
 ViewGeoEnforcer::~ViewGeoEnforcer() {
+    stop_animation();
     view->disconnect(&on_geometry_changed);
 }
 
@@ -217,62 +276,244 @@ void ViewGeoEnforcer::unref_disable() {
     disabled--;
 }
 
+/// Linearly interpolate between two geometries.
+static wf::geometry_t interpolate_geometry(wf::geometry_t a, wf::geometry_t b,
+                                           double t) {
+    const auto lerp = [t](int x, int y) {
+        return (int)std::lround(x + (y - x) * t);
+    };
+    return {
+        lerp(a.x, b.x),
+        lerp(a.y, b.y),
+        lerp(a.width, b.width),
+        lerp(a.height, b.height),
+    };
+}
+
+bool ViewGeoEnforcer::should_animate() const {
+    const auto ws = view_node->ws;
+
+    // Interactive gestures must follow the pointer without delay.
+    return ws->plugin->animation_duration > 0 && !ws->plugin->active_grab &&
+           !view_node->get_floating() && !view_node->is_hidden() &&
+           ws->is_visible() && !is_shutting_down();
+}
+
+void ViewGeoEnforcer::start_animation(wf::geometry_t from, wf::geometry_t to) {
+    const auto output = view_node->ws->output;
+
+    if (animation && animation->output != output)
+        stop_animation();
+    if (!animation)
+        output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+
+    animation = Animation{
+        from,
+        to,
+        std::chrono::steady_clock::now(),
+        std::chrono::milliseconds(view_node->ws->plugin->animation_duration),
+        output,
+    };
+    output->render->schedule_redraw();
+}
+
+void ViewGeoEnforcer::stop_animation() {
+    if (!animation)
+        return;
+
+    animation->output->render->rem_effect(&on_frame);
+    animation = std::nullopt;
+}
+
+void ViewGeoEnforcer::step_animation() {
+    if (!animation)
+        return;
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - animation->start;
+    const double t =
+        std::min(1.0, elapsed.count() / (double)animation->duration.count());
+
+    // Ease out cubic.
+    const double eased = 1.0 - (1.0 - t) * (1.0 - t) * (1.0 - t);
+    displayed_geo = interpolate_geometry(animation->from, animation->to, eased);
+
+    if (t >= 1.0)
+        stop_animation();
+    else
+        animation->output->render->schedule_redraw();
+
+    enforce();
+}
+
 void ViewGeoEnforcer::update_transformer() {
+    const auto target =
+        view_node->constrain_inner_geometry(view_node->get_inner_geometry());
+    const auto wsid = view_node->ws->wsid;
+    const bool same_ws = displayed_geo && displayed_wsid == wsid;
+
+    if (disabled) {
+        stop_animation();
+        displayed_geo = std::nullopt;
+    } else if (animation && same_ws && animation->to == target) {
+        // The client committed a new buffer mid-animation, restretch it.
+    } else if (same_ws && *displayed_geo != target && should_animate()) {
+        // Animations only move the buffer around, the client is configured to
+        // the final geometry once, up front.
+        start_animation(*displayed_geo, target);
+    } else {
+        stop_animation();
+        displayed_geo = target;
+        displayed_wsid = wsid;
+    }
+
+    enforce();
+}
+
+void ViewGeoEnforcer::enforce() {
     auto curr = view->get_wm_geometry();
 
     if (curr.width <= 0 && curr.height <= 0)
         return;
 
-    auto geo = view_node->get_inner_geometry();
+    view_node->push_disable_on_geometry_changed();
+    view->damage();
+
+    auto geo = displayed_geo ? *displayed_geo : curr;
 
     auto output = view_node->ws->output;
-    auto wsid = view_node->ws->wsid;
     auto curr_wsid = output->workspace->get_current_workspace();
-    if (wsid != curr_wsid)
-        geo = nonwf::local_to_relative_geometry(geo, wsid, curr_wsid, output);
+    if (displayed_geo && displayed_wsid != curr_wsid)
+        geo = nonwf::local_to_relative_geometry(geo, displayed_wsid, curr_wsid,
+                                                output);
 
     if (disabled || curr == geo) {
         scale_x = 1;
         scale_y = 1;
         translation_x = 0;
         translation_y = 0;
+    } else {
+        scale_x = (float)geo.width / (float)curr.width;
+        scale_y = (float)geo.height / (float)curr.height;
 
-        view_node->push_disable_on_geometry_changed();
-        view->damage();
-        view_node->pop_disable_on_geometry_changed();
-        return;
+        translation_x = (float)geo.x - (float)curr.x +
+                        ((float)geo.width - (float)curr.width) / 2.0f;
+        translation_y = (float)geo.y - (float)curr.y +
+                        ((float)geo.height - (float)curr.height) / 2.0f;
     }
 
-    scale_x = (float)geo.width / (float)curr.width;
-    scale_y = (float)geo.height / (float)curr.height;
-
-    translation_x = (float)geo.x - (float)curr.x +
-                    ((float)geo.width - (float)curr.width) / 2.0f;
-    translation_y = (float)geo.y - (float)curr.y +
-                    ((float)geo.height - (float)curr.height) / 2.0f;
-
-    view_node->push_disable_on_geometry_changed();
     view->damage();
     view_node->pop_disable_on_geometry_changed();
 }
 
+// MruList
+
+MruHook &MruList::hook_of(ViewNodeRef node) const { return (*node).*hook; }
+
+MruList::~MruList() {
+    for (auto node = head; node;) {
+        auto &h = hook_of(node);
+        node = h.next;
+        h = {};
+    }
+}
+
+void MruList::touch(ViewNodeRef node) {
+    if (head == node)
+        return;
+
+    remove(node);
+
+    auto &h = hook_of(node);
+    h.next = head;
+    h.list = this;
+    if (head)
+        hook_of(head).prev = node;
+    else
+        tail = node;
+    head = node;
+}
+
+void MruList::remove(ViewNodeRef node) {
+    auto &h = hook_of(node);
+    if (h.list.get() != this)
+        return;
+
+    if (h.prev)
+        hook_of(h.prev).next = h.next;
+    else
+        head = h.next;
+
+    if (h.next)
+        hook_of(h.next).prev = h.prev;
+    else
+        tail = h.prev;
+
+    if (cursor == node)
+        cursor = nullptr;
+
+    h = {};
+}
+
+bool MruList::contains(ViewNodeRef node) const {
+    return hook_of(node).list.get() == this;
+}
+
+ViewNodeRef MruList::next(ViewNodeRef node) const {
+    return contains(node) ? hook_of(node).next : nullptr;
+}
+
+ViewNodeRef MruList::prev(ViewNodeRef node) const {
+    return contains(node) ? hook_of(node).prev : nullptr;
+}
+
 // ViewNode
 
 ViewNode::ViewNode(wayfire_view view) : view(view) {
-    auto ge = std::make_shared<ViewGeoEnforcer>(this);
-    view->get_transformed_node()->add_transformer(ge, wf::TRANSFORMER_HIGHLEVEL - 1);
+    enforcer_transformer = std::make_shared<ViewGeoEnforcer>(this);
+    geo_enforcer = enforcer_transformer.get();
+    view->get_transformed_node()->add_transformer(
+        enforcer_transformer, wf::TRANSFORMER_HIGHLEVEL - 1);
 
-    geometry = expand_geometry(view->get_wm_geometry());
+    const auto wm_geo = view->get_wm_geometry();
+    geometry = expand_geometry(wm_geo);
     floating_geometry = geometry;
+    configured_size = {wm_geo.width, wm_geo.height};
 
     view->connect(&on_mapped);
     view->connect(&on_unmapped);
     view->connect(&on_geometry_changed);
     view->connect(&on_title_changed);
+    view->connect(&on_hints_changed);
+
+    on_commit.set_callback([&](void *) { update_constraints(); });
+    on_xwayland_set_hints.set_callback([&](void *) { update_constraints(); });
+    connect_size_hints();
+
+    update_constraints();
+}
+
+void ViewNode::connect_size_hints() {
+    on_commit.disconnect();
+    on_xwayland_set_hints.disconnect();
+
+    // Clients can change their size hints without resizing.
+    const auto surface = view->get_wlr_surface();
+    if (!surface)
+        return;
+
+    on_commit.connect(&surface->events.commit);
+#if WF_HAS_XWAYLAND
+    if (wlr_surface_is_xwayland_surface(surface))
+        on_xwayland_set_hints.connect(
+            &wlr_xwayland_surface_from_wlr_surface(surface)->events.set_hints);
+#endif
 }
 
 ViewNode::~ViewNode() {
     LOGD("Destroying ", this);
+    set_hidden(false);
+
     DetachedSignalData data = {};
     data._node = this;
     emit(&data);
@@ -281,6 +522,14 @@ ViewNode::~ViewNode() {
 
     close_subsurfaces();
 
+    if (ws_mru_hook.list)
+        ws_mru_hook.list->remove(this);
+    if (output_mru_hook.list)
+        output_mru_hook.list->remove(this);
+
+    on_xwayland_set_hints.disconnect();
+    on_commit.disconnect();
+    view->disconnect(&on_hints_changed);
     view->disconnect(&on_title_changed);
     view->disconnect(&on_geometry_changed);
     view->disconnect(&on_unmapped);
@@ -294,12 +543,30 @@ ViewNode::~ViewNode() {
 void ViewNode::on_unmapped_impl() {
     // ws might get unset on remove_child so we must save it.
     auto ws = this->ws;
+    const bool was_active = ws->get_active_node().get() == this;
+
+    if (ws->get_fullscreen_node().get() == this)
+        ws->set_fullscreen_node(nullptr);
 
     (void)ws->remove_node(this);
     // view node dies here.
+
+    // Focus the node that was active before, picked from the history.
+    if (was_active && ws->is_visible())
+        ws->get_active_node()->set_active();
 }
 
 void ViewNode::on_geometry_changed_impl() {
+    update_constraints();
+
+    // The client committed the size we asked for.
+    if (configure_timeout.is_connected()) {
+        const auto wm_geo = view->get_wm_geometry();
+        if (wm_geo.width == configured_size.width &&
+            wm_geo.height == configured_size.height)
+            on_configure_acked();
+    }
+
     if (disable_on_geometry_changed == 0) {
         if (get_floating()) {
             const auto curr_wsid =
@@ -335,12 +602,26 @@ void ViewNode::set_geometry(wf::geometry_t geo) {
     if (pure_set_geo)
         return;
 
+    // The batch only lays out the tiled tree once done. Views of floating
+    // trees, floating splits' children included, are laid out right away.
+    if (ws && ws->is_batching_layout() && parent && !find_floating_parent())
+        return;
+
+    // Don't configure views nobody can see. They are laid out again once the
+    // ws becomes visible.
+    if (ws && ws->is_deferring_layout()) {
+        geometry_pending = true;
+        ws->mark_layout_pending();
+        return;
+    }
+    geometry_pending = false;
+
     GeometryChangedSignalData data;
     data.old_geo = old_geo;
     data.new_geo = geometry;
     emit(&data);
 
-    auto inner = get_inner_geometry();
+    auto inner = constrain_inner_geometry(get_inner_geometry());
 
     auto curr_wsid = ws->output->workspace->get_current_workspace();
     if (ws->wsid != curr_wsid)
@@ -348,12 +629,158 @@ void ViewNode::set_geometry(wf::geometry_t geo) {
                                                   ws->output);
 
     push_disable_on_geometry_changed();
-    view->set_geometry(inner);
+    configure_view(inner);
     pop_disable_on_geometry_changed();
 
     geo_enforcer->update_transformer();
 }
 
+void ViewNode::configure_view(wf::geometry_t inner) {
+    const auto wm_geo = view->get_wm_geometry();
+    const bool same_size = inner.width == configured_size.width &&
+                           inner.height == configured_size.height;
+    const bool client_has_size = wm_geo.width == configured_size.width &&
+                                 wm_geo.height == configured_size.height;
+
+    // Moves don't need the client's cooperation. The view may also have been
+    // resized behind our back (e.g. fullscreen), in which case resend it.
+    if (same_size && (configure_timeout.is_connected() || client_has_size)) {
+        queued_configure = std::nullopt;
+        view->move(inner.x, inner.y);
+        return;
+    }
+
+    // Don't pile up configures on a client that is lagging behind. The geo
+    // enforcer stretches its current buffer in the meantime.
+    if (configure_timeout.is_connected()) {
+        queued_configure = inner;
+        view->move(inner.x, inner.y);
+        recorder::record(recorder::RecordType::CONFIGURE_QUEUED, node_id, 0,
+                         inner);
+        return;
+    }
+
+    recorder::record(recorder::RecordType::CONFIGURE, node_id, 0, inner);
+    configured_size = {inner.width, inner.height};
+
+    if (auto &perf = ws->plugin->perf; perf.enabled) {
+        perf.configures++;
+        configure_sent = PerfCounters::Clock::now();
+    }
+
+    view->set_geometry(inner);
+    configure_timeout.set_timeout(CONFIGURE_ACK_TIMEOUT,
+                                  [&]() { on_configure_acked(); });
+}
+
+/// The size hints of a client, in inner dimensions. Unset limits are 0.
+struct ClientSizeHints {
+    wf::dimensions_t min{0, 0};  ///< Minimum size.
+    wf::dimensions_t max{0, 0};  ///< Maximum size.
+    wf::dimensions_t base{0, 0}; ///< Base size of the increments.
+    wf::dimensions_t inc{1, 1};  ///< Size increments.
+};
+
+/// Get the size hints of the client of a view.
+static ClientSizeHints get_client_size_hints(wayfire_view view) {
+    ClientSizeHints hints;
+    const auto surface = view->get_wlr_surface();
+    if (!surface)
+        return hints;
+
+    if (wlr_surface_is_xdg_surface(surface)) {
+        const auto xdg = wlr_xdg_surface_from_wlr_surface(surface);
+        if (xdg->role == WLR_XDG_SURFACE_ROLE_TOPLEVEL && xdg->toplevel) {
+            const auto &state = xdg->toplevel->current;
+            hints.min = {state.min_width, state.min_height};
+            hints.max = {state.max_width, state.max_height};
+        }
+    }
+#if WF_HAS_XWAYLAND
+    else if (wlr_surface_is_xwayland_surface(surface)) {
+        const auto xsurface = wlr_xwayland_surface_from_wlr_surface(surface);
+        if (const auto sh = xsurface->size_hints) {
+            hints.min = {std::max(0, sh->min_width),
+                         std::max(0, sh->min_height)};
+            hints.max = {std::max(0, sh->max_width),
+                         std::max(0, sh->max_height)};
+            hints.base = {std::max(0, sh->base_width),
+                          std::max(0, sh->base_height)};
+            hints.inc = {std::max(1, sh->width_inc),
+                         std::max(1, sh->height_inc)};
+        }
+    }
+#endif
+
+    return hints;
+}
+
+/// Clamp size to the hinted limits along one axis and round it down to the
+/// closest increment.
+static std::int32_t constrain_size(std::int32_t size, std::int32_t min,
+                                   std::int32_t max, std::int32_t base,
+                                   std::int32_t inc) {
+    if (inc > 1 && size > base)
+        size = base + (size - base) / inc * inc;
+    if (max > 0)
+        size = std::min(size, max);
+    return std::max(size, min);
+}
+
+wf::geometry_t ViewNode::constrain_inner_geometry(wf::geometry_t inner) {
+    const auto hints = get_client_size_hints(view);
+    inner.width = constrain_size(inner.width, hints.min.width,
+                                 hints.max.width, hints.base.width,
+                                 hints.inc.width);
+    inner.height = constrain_size(inner.height, hints.min.height,
+                                  hints.max.height, hints.base.height,
+                                  hints.inc.height);
+    return inner;
+}
+
+SizeConstraints ViewNode::compute_constraints() {
+    const auto hints = get_client_size_hints(view);
+    const auto pad_w = padding.left + padding.right;
+    const auto pad_h = padding.top + padding.bottom;
+
+    SizeConstraints ncons;
+    ncons.min = {
+        std::max(MIN_VIEW_SIZE, hints.min.width + pad_w),
+        std::max(MIN_VIEW_SIZE, hints.min.height + pad_h),
+    };
+    if (hints.max.width > 0)
+        ncons.max.width = std::max(ncons.min.width, hints.max.width + pad_w);
+    if (hints.max.height > 0)
+        ncons.max.height =
+            std::max(ncons.min.height, hints.max.height + pad_h);
+
+    return ncons;
+}
+
+void ViewNode::on_configure_acked() {
+    configure_timeout.disconnect();
+    recorder::record(recorder::RecordType::CONFIGURE_ACKED, node_id, 0,
+                     view->get_wm_geometry());
+
+    if (auto sent = std::exchange(configure_sent, std::nullopt))
+        ack_latency = PerfCounters::Clock::now() - *sent;
+
+    if (auto queued = std::exchange(queued_configure, std::nullopt)) {
+        push_disable_on_geometry_changed();
+        configure_view(*queued);
+        pop_disable_on_geometry_changed();
+
+        geo_enforcer->update_transformer();
+    }
+}
+
+PerfCounters::Clock::duration ViewNode::get_ack_latency() const {
+    if (!configure_sent)
+        return ack_latency;
+
+    return std::max(ack_latency, PerfCounters::Clock::now() - *configure_sent);
+}
+
 SplitNodeRef ViewNode::try_upgrade() {
     if (auto split_type = get_prefered_split_type()) {
         auto new_parent =
@@ -383,7 +810,29 @@ void ViewNode::set_prefered_split_type(std::optional<SplitType> split_type) {
 
 void ViewNode::set_sublayer(nonstd::observer_ptr<wf::scene::floating_inner_ptr> sublayer) {
     INode::set_sublayer(sublayer);
-    get_ws()->output->workspace->add_view_to_sublayer(view, sublayer);
+
+    // The view stays alone above its ws until it leaves fullscreen.
+    get_ws()->output->workspace->add_view_to_sublayer(
+        view, fullscreen ? get_ws()->fullscreen_sublayer : sublayer);
+}
+
+void ViewNode::set_fullscreen(bool f) {
+    if (f == fullscreen)
+        return;
+    fullscreen = f;
+
+    const auto tnode = view->get_transformed_node();
+    if (fullscreen) {
+        // Direct scanout needs an untransformed view.
+        tnode->rem_transformer(enforcer_transformer);
+        ws->set_fullscreen_node(this);
+    } else {
+        tnode->add_transformer(enforcer_transformer,
+                               wf::TRANSFORMER_HIGHLEVEL - 1);
+        if (ws->get_fullscreen_node().get() == this)
+            ws->set_fullscreen_node(nullptr);
+        set_sublayer(ws->get_child_sublayer(find_root_parent()));
+    }
 }
 
 void ViewNode::bring_to_front() {
@@ -402,7 +851,14 @@ void ViewNode::bring_to_front() {
         v->damage();
 }
 
+void ViewNode::set_urgent(bool urgent) {
+    if (urgent != is_urgent())
+        add_urgent_count(urgent ? 1 : -1);
+}
+
 void ViewNode::on_set_active() {
+    set_urgent(false);
+
     for (auto view : view->enumerate_views())
         if (view->activated)
             return;
@@ -417,6 +873,10 @@ NodeParent ViewNode::get_or_upgrade_to_parent_node() {
         return parent;
 }
 
+void ViewNode::on_set_hidden() {
+    wf::scene::set_node_enabled(view->get_root_node(), !hidden);
+}
+
 void ViewNode::for_each_node(const std::function<void(Node)> &f) { f(this); }
 
 // SplitNode
@@ -454,17 +914,91 @@ void SplitNode::sync_sizes_to_ratios() {
     assert("Cannot sync sizes to ratios when children are stacked." &&
            is_split());
 
-    const auto total_size = split_type == SplitType::VSPLIT
-                                ? get_inner_geometry().width
-                                : get_inner_geometry().height;
+    const bool horizontal = split_type == SplitType::VSPLIT;
+    const std::int32_t total_size = horizontal ? get_inner_geometry().width
+                                               : get_inner_geometry().height;
+
+    // Size the children by ratio within their constraints.
+    std::int32_t size_left = total_size;
+    for (auto &c : children) {
+        const auto &cons = c.node->get_constraints();
+        c.size = (std::uint32_t)std::clamp(
+            (std::int32_t)(c.ratio * (double)total_size),
+            cons.get_min(horizontal), cons.get_max(horizontal));
+        size_left -= (std::int32_t)c.size;
+    }
 
-    auto size_left = total_size;
-    for (auto &c : children | nonstd::skip_last) {
-        c.size = (std::uint32_t)(c.ratio * (double)total_size);
-        size_left -= c.size;
+    // Hand the rounding error and what the clamped children couldn't take to
+    // the children that still can, last first.
+    const auto distribute = [&](bool constrained) {
+        for (auto &c : children | nonstd::reverse) {
+            if (size_left == 0)
+                return;
+
+            const auto &cons = c.node->get_constraints();
+            const std::int32_t old_size = c.size;
+            const std::int32_t nsize =
+                constrained ? std::clamp(old_size + size_left,
+                                         cons.get_min(horizontal),
+                                         cons.get_max(horizontal))
+                            : std::max(1, old_size + size_left);
+
+            c.size = (std::uint32_t)nsize;
+            size_left -= nsize - old_size;
+        }
+    };
+
+    distribute(true);
+
+    // The children don't fit: the sizes must still add up.
+    distribute(false);
+}
+
+std::vector<double> SplitNode::get_ratios() const {
+    std::vector<double> ratios;
+    ratios.reserve(children.size());
+
+    std::uint32_t total_size = 0;
+    for (const auto &c : children)
+        total_size += c.size;
+
+    // Sizes are more up to date than ratios during and after resizes.
+    const bool use_sizes = (split_type == SplitType::VSPLIT ||
+                            split_type == SplitType::HSPLIT) &&
+                           total_size != 0;
+
+    for (const auto &c : children)
+        ratios.push_back(use_sizes ? (double)c.size / (double)total_size
+                                   : c.ratio);
+
+    return ratios;
+}
+
+void SplitNode::set_ratios(const std::vector<double> &ratios) {
+    if (ratios.size() != children.size()) {
+        LOGE(this, ": Cannot set ", ratios.size(), " ratios on ",
+             children.size(), " children.");
+        return;
     }
 
-    children.back().size = size_left;
+    double total = 0;
+    for (auto r : ratios)
+        total += r;
+
+    if (children.empty() || total <= 0)
+        return;
+
+    double total_ratio = 0;
+    for (std::size_t i = 0; i + 1 < children.size(); i++) {
+        children[i].ratio = ratios[i] / total;
+        total_ratio += children[i].ratio;
+    }
+    children.back().ratio = 1.0 - total_ratio;
+
+    if (is_split())
+        sync_sizes_to_ratios();
+
+    refresh_geometry();
 }
 
 void SplitNode::insert_child_at(SplitChildIter at, OwnedNode node) {
@@ -473,6 +1007,7 @@ void SplitNode::insert_child_at(SplitChildIter at, OwnedNode node) {
     node->set_ws(get_ws());
     node->set_sublayer(get_ws()->get_child_sublayer(find_root_parent()));
     node->notify_initialized();
+    add_urgent_count((std::int32_t)node->get_urgent_count());
 
     double total_ratio = 0;
     if (!children.empty()) {
@@ -494,16 +1029,22 @@ void SplitNode::insert_child_at(SplitChildIter at, OwnedNode node) {
     nchild.ratio = 1.0 - total_ratio;
 
     children.insert(at, std::move(nchild));
+    update_constraints();
 
     if (is_split())
         sync_sizes_to_ratios();
 
+    refresh_children_hidden();
+
     ChildInsertedSignal data;
     data.node = node_ref;
     emit(&data);
     emit_title_changed();
 
     refresh_geometry();
+
+    recorder::record(recorder::RecordType::INSERT_CHILD, node_ref->get_id(),
+                     node_id, node_ref->get_geometry());
 }
 
 void SplitNode::insert_child_front(OwnedNode node) {
@@ -553,6 +1094,7 @@ OwnedNode SplitNode::remove_child_at(SplitChildIter child) {
 
     auto owned_node = std::move(child->node);
     children.erase(child);
+    update_constraints();
 
     if (children.empty()) {
         active_child = 0;
@@ -576,6 +1118,9 @@ OwnedNode SplitNode::remove_child_at(SplitChildIter child) {
             sync_sizes_to_ratios();
     }
 
+    owned_node->set_hidden(false);
+    refresh_children_hidden();
+
     ChildRemovedSignal data;
     data.node = owned_node.get();
     emit(&data);
@@ -583,8 +1128,12 @@ OwnedNode SplitNode::remove_child_at(SplitChildIter child) {
 
     refresh_geometry();
 
+    add_urgent_count(-(std::int32_t)owned_node->get_urgent_count());
     owned_node->parent = nullptr;
 
+    recorder::record(recorder::RecordType::REMOVE_CHILD, owned_node->get_id(),
+                     node_id, owned_node->get_geometry());
+
     return owned_node;
 }
 
@@ -597,6 +1146,14 @@ void SplitNode::set_active_child(Node node) {
 
     active_child = std::distance(children.begin(), child);
 
+    // The geometry of hidden stack children is only applied once visible.
+    // Until the client commits its new size, the geo enforcer stretches the
+    // last buffer it had to the new geometry.
+    if (is_stack()) {
+        refresh_children_hidden();
+        child->node->flush_pending_geometry();
+    }
+
     parent->set_active_child(this);
     emit_title_changed();
 }
@@ -605,11 +1162,72 @@ Node SplitNode::get_active_child() const { return child_at(active_child); }
 
 void SplitNode::notify_child_title_changed(Node child) { emit_title_changed(); }
 
+void SplitNode::notify_child_urgency_changed(Node child, std::int32_t delta) {
+    ChildUrgencyChangedSignal data;
+    data.node = child;
+    emit(&data);
+
+    add_urgent_count(delta);
+}
+
+void SplitNode::notify_child_constraints_changed(Node child) {
+    (void)child;
+    update_constraints();
+}
+
+SizeConstraints SplitNode::compute_constraints() {
+    SizeConstraints ncons;
+    if (children.empty())
+        return ncons;
+
+    // Splits lay their children out along one axis and stretch them across
+    // the other. Stacks stretch them along both.
+    const bool horizontal = split_type != SplitType::HSPLIT;
+    std::int32_t along_min = 0;
+    std::int32_t along_max = is_split() ? 0 : UNBOUNDED_SIZE;
+    std::int32_t across_min = 0;
+    std::int32_t across_max = UNBOUNDED_SIZE;
+
+    for (const auto &c : children) {
+        const auto &cons = c.node->get_constraints();
+        if (is_split()) {
+            along_min += cons.get_min(horizontal);
+            along_max = std::min(UNBOUNDED_SIZE,
+                                 along_max + cons.get_max(horizontal));
+        } else {
+            along_min = std::max(along_min, cons.get_min(horizontal));
+            along_max = std::min(along_max, cons.get_max(horizontal));
+        }
+        across_min = std::max(across_min, cons.get_min(!horizontal));
+        across_max = std::min(across_max, cons.get_max(!horizontal));
+    }
+
+    // Conflicting maximums give way to the minimums.
+    along_max = std::max(along_max, along_min);
+    across_max = std::max(across_max, across_min);
+
+    const auto pad_w = padding.left + padding.right;
+    const auto pad_h = padding.top + padding.bottom;
+    if (horizontal) {
+        ncons.min = {along_min + pad_w, across_min + pad_h};
+        ncons.max = {along_max + pad_w, across_max + pad_h};
+    } else {
+        ncons.min = {across_min + pad_w, along_min + pad_h};
+        ncons.max = {across_max + pad_w, along_max + pad_h};
+    }
+
+    return ncons;
+}
+
 void SplitNode::set_split_type(SplitType st) {
     if (is_split())
         was_vsplit = split_type == SplitType::VSPLIT;
     split_type = st;
+    update_constraints();
+    refresh_children_hidden();
     refresh_geometry();
+    recorder::record(recorder::RecordType::SET_SPLIT_TYPE, node_id, 0,
+                     geometry, (std::uint32_t)st);
     SplitTypeChangedSignal sig;
     emit(&sig);
     emit_title_changed();
@@ -659,6 +1277,12 @@ OwnedNode SplitNode::swap_child(Node node, OwnedNode other) {
     other->set_geometry(child->node->get_geometry());
 
     std::swap(child->node, other);
+    add_urgent_count((std::int32_t)child->node->get_urgent_count() -
+                     (std::int32_t)other->get_urgent_count());
+    update_constraints();
+
+    other->set_hidden(false);
+    refresh_children_hidden();
 
     child->node->notify_initialized();
 
@@ -668,6 +1292,9 @@ OwnedNode SplitNode::swap_child(Node node, OwnedNode other) {
     emit(&data);
     emit_title_changed();
 
+    recorder::record(recorder::RecordType::SWAP_CHILD, child->node->get_id(),
+                     other->get_id(), child->node->get_geometry());
+
     return other;
 }
 
@@ -682,6 +1309,11 @@ void SplitNode::swap_children(Node a, Node b) {
 
     std::iter_swap(child_a, child_b);
 
+    refresh_children_hidden();
+
+    recorder::record(recorder::RecordType::SWAP_CHILDREN, a->get_id(),
+                     b->get_id(), geometry);
+
     ChildrenSwappedSignal sig;
     emit(&sig);
     emit_title_changed();
@@ -914,6 +1546,32 @@ void SplitNode::bring_to_front() {
         ac->bring_to_front();
 }
 
+void SplitNode::refresh_children_hidden() {
+    for (std::size_t i = 0; i < children.size(); i++)
+        children[i].node->set_hidden(hidden ||
+                                     (is_stack() && i != active_child));
+}
+
+void SplitNode::on_set_hidden() { refresh_children_hidden(); }
+
+void ViewNode::set_ws(WorkspaceRef ws) {
+    const auto old_ws = this->ws;
+    INode::set_ws(ws);
+
+    // Carry the fullscreen state over to the new ws.
+    if (fullscreen && old_ws.get() != ws.get()) {
+        if (old_ws && old_ws->get_fullscreen_node().get() == this)
+            old_ws->set_fullscreen_node(nullptr);
+        ws->set_fullscreen_node(this);
+    }
+
+    // Carry the focus history over to the new ws.
+    if (old_ws && old_ws.get() != ws.get() && ws_mru_hook.list) {
+        old_ws->mru.remove(this);
+        ws->mru.touch(this);
+    }
+}
+
 void SplitNode::set_ws(WorkspaceRef ws) {
     INode::set_ws(ws);
 
@@ -959,19 +1617,28 @@ void SplitNode::set_geometry(const wf::geometry_t geo) {
     geometry = geo;
 
     if (children.empty()) {
-        if (parent->as_split_node())
+        // Splits are transiently empty while a batch rebuilds the tree.
+        if (parent->as_split_node() && !ws->is_batching_layout())
             LOGE(this, ": Attempt to set geometry of empty split node.");
         return;
     }
 
     if (pure_set_geo)
         return;
+    geometry_pending = false;
 
     GeometryChangedSignalData data;
     data.old_geo = old_geo;
     data.new_geo = geometry;
     emit(&data);
 
+    layout_children();
+}
+
+void SplitNode::layout_children() {
+    if (children.empty())
+        return;
+
     auto inner = get_inner_geometry();
 
     switch (split_type) {
@@ -981,12 +1648,20 @@ void SplitNode::set_geometry(const wf::geometry_t geo) {
             split_type == SplitType::VSPLIT ? inner.width : inner.height;
 
         {
+            const bool horizontal = split_type == SplitType::VSPLIT;
             std::uint32_t total_children_size = 0;
-            for (auto &c : children)
+            bool constrained = true;
+            for (auto &c : children) {
+                const auto &cons = c.node->get_constraints();
+                const auto csize = (std::int32_t)c.size;
                 total_children_size += c.size;
+                constrained = constrained &&
+                              csize >= cons.get_min(horizontal) &&
+                              csize <= cons.get_max(horizontal);
+            }
 
-            // Fix improper total child size by resyncing with ratios.
-            if (total_children_size != size)
+            // Fix improper child sizes by resyncing with ratios.
+            if (total_children_size != size || !constrained)
                 sync_sizes_to_ratios();
         }
 
@@ -1016,8 +1691,14 @@ void SplitNode::set_geometry(const wf::geometry_t geo) {
     }
     case SplitType::TABBED:
     case SplitType::STACKED: {
-        for (auto &child : children)
-            child.node->set_geometry(inner);
+        // Only the active child is visible. The others get configured once
+        // they are made active.
+        for (std::size_t i = 0; i < children.size(); i++) {
+            if (i == active_child)
+                children[i].node->set_geometry(inner);
+            else
+                children[i].node->set_geometry_deferred(inner);
+        }
         break;
     }
     }
@@ -1038,6 +1719,8 @@ Workspace::Workspace(wf::point_t wsid, wf::geometry_t geo,
 
     floating_sublayer = output->workspace->create_sublayer(
         wf::LAYER_WORKSPACE, wf::SUBLAYER_DOCKED_ABOVE);
+    fullscreen_sublayer = output->workspace->create_sublayer(
+        wf::LAYER_WORKSPACE, wf::SUBLAYER_DOCKED_ABOVE);
 
     output->connect(&on_workarea_changed);
 }
@@ -1046,12 +1729,37 @@ Workspace::~Workspace() {
     output->disconnect(&on_workarea_changed);
     output->workspace->destroy_sublayer(tiled_root.sublayer);
     output->workspace->destroy_sublayer(floating_sublayer);
+    output->workspace->destroy_sublayer(fullscreen_sublayer);
+}
+
+void Workspace::set_fullscreen_node(ViewNodeRef node) {
+    if (fullscreen_node.get() == node.get())
+        return;
+    fullscreen_node = node;
+
+    // The tiles, their decorations and the floating nodes are all in these
+    // sublayers.
+    const bool enabled = !fullscreen_node;
+    wf::scene::set_node_enabled(*tiled_root.sublayer, enabled);
+    wf::scene::set_node_enabled(*floating_sublayer, enabled);
+
+    if (fullscreen_node)
+        output->workspace->add_view_to_sublayer(fullscreen_node->view,
+                                                fullscreen_sublayer);
+
+    plugin->sticky.refresh_enabled();
+    output->render->damage_whole();
 }
 
 void Workspace::set_active_node(Node node) {
     const auto old_node = active_node;
     active_node = node;
 
+    recorder::record(recorder::RecordType::SET_ACTIVE,
+                     node ? node->get_id() : 0,
+                     old_node ? old_node->get_id() : 0,
+                     node ? node->get_geometry() : wf::geometry_t{0, 0, 0, 0});
+
     ActiveNodeChangedSignalData data;
     data.old_node = old_node;
     data.new_node = active_node;
@@ -1060,6 +1768,19 @@ void Workspace::set_active_node(Node node) {
     if (!node)
         return;
 
+    if (auto vnode = node->as_view_node()) {
+        mru.touch(vnode);
+
+        // Focusing outside of a cycle commits the node cycled to.
+        if (!plugin->mru_cycling) {
+            if (auto cursor = plugin->mru.cursor) {
+                plugin->mru.touch(cursor);
+                plugin->mru.cursor = nullptr;
+            }
+            plugin->mru.touch(vnode);
+        }
+    }
+
     node->parent->set_active_child(node);
     node->find_root_parent()->bring_to_front();
     node->on_set_active();
@@ -1071,6 +1792,11 @@ Node Workspace::get_active_node() {
 }
 
 void Workspace::insert_floating_node(OwnedNode node) {
+    if (StickyLayer::wants_sticky(node)) {
+        plugin->sticky.insert_child(std::move(node));
+        return;
+    }
+
     node->parent = this;
     node->set_floating(true);
     node->set_ws(this);
@@ -1079,6 +1805,10 @@ void Workspace::insert_floating_node(OwnedNode node) {
 
     const Node node_ref = node;
     floating_nodes.push_back({std::move(node), floating_sublayer});
+    add_urgent_count((std::int32_t)node_ref->get_urgent_count());
+
+    recorder::record(recorder::RecordType::INSERT_FLOATING, node_ref->get_id(),
+                     0, node_ref->get_geometry(), recorder::pack_wsid(wsid));
 
     RootNodeChangedSignalData data;
     data.workspace = this;
@@ -1094,6 +1824,13 @@ Workspace::FloatingNodeIter Workspace::find_floating(Node node) {
 }
 
 OwnedNode Workspace::remove_floating_node(Node node, bool reset_active) {
+    if (plugin->sticky.contains(node)) {
+        auto owned_node = plugin->sticky.remove_child(node);
+        if (reset_active && node.get() == active_node.get())
+            reset_active_node();
+        return owned_node;
+    }
+
     auto child = find_floating(node);
     if (child == floating_nodes.end()) {
         LOGE("Node not floating in ", this, ": ", node);
@@ -1103,6 +1840,11 @@ OwnedNode Workspace::remove_floating_node(Node node, bool reset_active) {
     auto owned_node = std::move(child->node);
 
     floating_nodes.erase(child);
+    add_urgent_count(-(std::int32_t)owned_node->get_urgent_count());
+
+    recorder::record(recorder::RecordType::REMOVE_FLOATING,
+                     owned_node->get_id(), 0, owned_node->get_geometry(),
+                     recorder::pack_wsid(wsid));
 
     if (floating_nodes.empty())
         active_floating = 0;
@@ -1118,6 +1860,9 @@ OwnedNode Workspace::remove_floating_node(Node node, bool reset_active) {
 }
 
 OwnedNode Workspace::swap_floating_node(Node node, OwnedNode other) {
+    if (plugin->sticky.contains(node))
+        return plugin->sticky.swap_child(node, std::move(other));
+
     auto child = find_floating(node);
     if (child == floating_nodes.end()) {
         LOGE("Node not floating in ", this, ": ", node);
@@ -1132,6 +1877,8 @@ OwnedNode Workspace::swap_floating_node(Node node, OwnedNode other) {
 
     // swap the pointers
     std::swap(child->node, other);
+    add_urgent_count((std::int32_t)child->node->get_urgent_count() -
+                     (std::int32_t)other->get_urgent_count());
 
     child->node->notify_initialized();
 
@@ -1162,6 +1909,9 @@ Workspace::swap_tiled_root(std::unique_ptr<SplitNode> other) {
     tiled_root.node->set_ws(this);
     tiled_root.node->set_sublayer(tiled_root.sublayer);
     tiled_root.node->notify_initialized();
+    if (ret)
+        add_urgent_count((std::int32_t)tiled_root.node->get_urgent_count() -
+                         (std::int32_t)ret->get_urgent_count());
 
     RootNodeChangedSignalData data;
     data.workspace = this;
@@ -1214,9 +1964,39 @@ OwnedNode Workspace::remove_node(Node node, bool reset_active) {
 }
 
 void Workspace::reset_active_node() {
+    for (auto node = mru.front(); node; node = mru.next(node)) {
+        if (node.get() != active_node.get() && is_attached(node)) {
+            active_node = node;
+            return;
+        }
+    }
+
     active_node = tiled_root.node->get_last_active_node();
 }
 
+bool Workspace::is_attached(ViewNodeRef node) {
+    Node child = node;
+    while (child->parent && child->get_ws().get() == this) {
+        if (auto split = child->parent->as_split_node()) {
+            if (!split->has_child(child))
+                return false;
+            child = split;
+            continue;
+        }
+
+        // The parent is this ws or the sticky layer reporting to it.
+        if (child.get() == tiled_root.node.get() ||
+            plugin->sticky.contains(child))
+            return true;
+
+        return std::any_of(floating_nodes.begin(), floating_nodes.end(),
+                           [&](const auto &floating) {
+                               return floating.node.get() == child.get();
+                           });
+    }
+    return false;
+}
+
 void Workspace::insert_child(OwnedNode node) {
     tiled_root.node->insert_child(std::move(node));
 }
@@ -1311,12 +2091,39 @@ void Workspace::set_active_child(Node node) {
     }
 }
 
+void Workspace::add_urgent_count(std::int32_t delta) {
+    if (delta == 0)
+        return;
+
+    assert(delta > 0 || urgent_count >= (std::uint32_t)-delta);
+    urgent_count += delta;
+
+    WorkspaceUrgencyChangedSignal data;
+    data.workspace = this;
+    output->emit(&data);
+}
+
+void Workspace::notify_child_urgency_changed(Node child, std::int32_t delta) {
+    // Nodes removed from this ws keep it as their parent.
+    if (child.get() != tiled_root.node.get() &&
+        find_floating(child) == floating_nodes.end())
+        return;
+
+    add_urgent_count(delta);
+}
+
 Node Workspace::get_active_child() const {
     return active_node->find_root_parent();
 }
 
 void Workspace::set_workarea(wf::geometry_t geo) {
     workarea = geo;
+
+    if (is_deferring_layout()) {
+        mark_layout_pending();
+        return;
+    }
+
     tiled_root.node->set_geometry(geo);
 
     for (auto &floating : floating_nodes) {
@@ -1337,10 +2144,33 @@ void Workspace::set_workarea(wf::geometry_t geo) {
     }
 }
 
+bool Workspace::is_visible() const {
+    return output->workspace->get_current_workspace() == wsid;
+}
+
+void Workspace::mark_layout_pending() {
+    if (!layout_pending)
+        plugin->schedule_layout_prefetch();
+    layout_pending = true;
+}
+
+void Workspace::flush_pending_layout() {
+    if (!layout_pending)
+        return;
+
+    layout_pending = false;
+    flushing_layout = true;
+    plugin->perf.time_layout([&]() { set_workarea(workarea); });
+    flushing_layout = false;
+}
+
 nonstd::observer_ptr<wf::scene::floating_inner_ptr> Workspace::get_child_sublayer(Node node) {
     if (node.get() == tiled_root.node.get())
         return tiled_root.sublayer;
 
+    if (plugin->sticky.contains(node))
+        return plugin->sticky.get_sublayer();
+
     auto child = find_floating(node);
     if (child == floating_nodes.end()) {
         LOGE("Node not a direct child of ", this, ": ", node);
@@ -1362,7 +2192,7 @@ void Workspace::tile_request(Node const node, const bool tile) {
             return;
 
         insert_floating_node(remove_tiled_node(node));
-        if (active_node.get() == node.get())
+        if (active_node.get() == node.get() && !plugin->sticky.contains(node))
             active_floating =
                 std::distance(floating_nodes.begin(), find_floating(node));
     }
@@ -1380,6 +2210,21 @@ void Workspace::for_each_node(const std::function<void(Node)> &f) {
     tiled_root.node->for_each_node(f);
 }
 
+void Workspace::batch_layout(const std::function<void()> &f) {
+    begin_layout_batch();
+    f();
+    end_layout_batch();
+}
+
+void Workspace::end_layout_batch() {
+    assert(layout_batch_depth);
+    layout_batch_depth--;
+
+    if (layout_batch_depth == 0)
+        plugin->perf.time_layout(
+            [&]() { tiled_root.node->refresh_geometry(); });
+}
+
 Node Workspace::get_last_active_node() { return active_node; }
 
 Node Workspace::get_adjacent(Node node, Direction dir) {
@@ -1463,6 +2308,160 @@ bool Workspace::move_child(Node node, Direction dir) {
     return false;
 }
 
+// StickyLayer
+
+void StickyLayer::init(OutputRef output, WorkspaceRef ws) {
+    this->output = output;
+    this->ws = ws;
+    sublayer = output->workspace->create_sublayer(wf::LAYER_WORKSPACE,
+                                                  wf::SUBLAYER_DOCKED_ABOVE);
+}
+
+void StickyLayer::fini() {
+    // Pop the nodes one by one so the layer stays consistent while each of
+    // them is destroyed.
+    while (!nodes.empty())
+        nodes.pop_back();
+
+    output->workspace->destroy_sublayer(sublayer);
+    sublayer = nullptr;
+}
+
+std::uint32_t StickyLayer::get_urgent_count() const {
+    std::uint32_t count = 0;
+    for (const auto &node : nodes)
+        count += node->get_urgent_count();
+    return count;
+}
+
+bool StickyLayer::wants_sticky(Node node) {
+    const auto vnode = node->as_view_node();
+    return vnode && vnode->view->sticky;
+}
+
+void StickyLayer::set_ws(WorkspaceRef ws) {
+    if (this->ws.get() == ws.get())
+        return;
+
+    const auto urgent = (std::int32_t)get_urgent_count();
+    if (this->ws)
+        this->ws->add_urgent_count(-urgent);
+    if (ws)
+        ws->add_urgent_count(urgent);
+
+    // Sticky views keep their place on the output, so their ws-local
+    // geometry is still right on the new ws.
+    this->ws = ws;
+    for (auto &node : nodes)
+        node->set_ws(ws);
+
+    refresh_enabled();
+}
+
+void StickyLayer::refresh_enabled() {
+    if (sublayer && ws)
+        wf::scene::set_node_enabled(*sublayer, !ws->get_fullscreen_node());
+}
+
+Node StickyLayer::get_adjacent(Node node, Direction dir) {
+    (void)node;
+    (void)dir;
+    return nullptr;
+}
+
+bool StickyLayer::move_child(Node node, Direction dir) {
+    return ws->move_child(node, dir);
+}
+
+wf::dimensions_t StickyLayer::try_resize_child(Node child,
+                                               wf::dimensions_t ndims,
+                                               std::uint32_t edges) {
+    return ws->try_resize_child(child, ndims, edges);
+}
+
+Node StickyLayer::get_last_active_node() { return ws->get_last_active_node(); }
+
+void StickyLayer::insert_child(OwnedNode node) {
+    node->parent = this;
+    node->set_floating(true);
+    node->set_ws(ws);
+    node->set_sublayer(sublayer);
+    node->notify_initialized();
+
+    const Node node_ref = node;
+    nodes.push_back(std::move(node));
+    ws->add_urgent_count((std::int32_t)node_ref->get_urgent_count());
+
+    recorder::record(recorder::RecordType::INSERT_FLOATING, node_ref->get_id(),
+                     0, node_ref->get_geometry(),
+                     recorder::pack_wsid(ws->wsid));
+}
+
+OwnedNode StickyLayer::remove_child(Node node) {
+    auto child = std::find_if(nodes.begin(), nodes.end(), [&](auto &n) {
+        return n.get() == node.get();
+    });
+    if (child == nodes.end()) {
+        LOGE("Node not in ", this, ": ", node);
+        return nullptr;
+    }
+
+    auto owned_node = std::move(*child);
+    nodes.erase(child);
+    ws->add_urgent_count(-(std::int32_t)owned_node->get_urgent_count());
+
+    recorder::record(recorder::RecordType::REMOVE_FLOATING,
+                     owned_node->get_id(), 0, owned_node->get_geometry(),
+                     recorder::pack_wsid(ws->wsid));
+
+    return owned_node;
+}
+
+OwnedNode StickyLayer::swap_child(Node node, OwnedNode other) {
+    auto child = std::find_if(nodes.begin(), nodes.end(), [&](auto &n) {
+        return n.get() == node.get();
+    });
+    if (child == nodes.end()) {
+        LOGE("Node not in ", this, ": ", node);
+        return nullptr;
+    }
+
+    other->parent = this;
+    other->set_floating(true);
+    other->set_ws(ws);
+    other->set_geometry((*child)->get_geometry());
+    other->set_sublayer(sublayer);
+
+    ws->add_urgent_count((std::int32_t)other->get_urgent_count() -
+                         (std::int32_t)(*child)->get_urgent_count());
+
+    std::swap(*child, other);
+    (*child)->notify_initialized();
+
+    return other;
+}
+
+void StickyLayer::swap_children(Node a, Node b) {
+    auto tmp = a->get_geometry();
+    a->set_geometry(b->get_geometry());
+    b->set_geometry(tmp);
+}
+
+void StickyLayer::set_active_child(Node node) { (void)node; }
+
+Node StickyLayer::get_active_child() const { return ws->get_active_child(); }
+
+void StickyLayer::notify_child_urgency_changed(Node child,
+                                               std::int32_t delta) {
+    // Nodes removed from this layer keep it as their parent.
+    if (std::find_if(nodes.begin(), nodes.end(), [&](auto &n) {
+            return n.get() == child.get();
+        }) == nodes.end())
+        return;
+
+    ws->add_urgent_count(delta);
+}
+
 // Workspaces
 
 void Workspaces::update_dims(wf::dimensions_t ndims, wf::geometry_t geo,
@@ -1491,6 +2490,11 @@ WorkspaceRef Workspaces::get(wf::point_t ws) {
     return workspaces.at(ws.x).at(ws.y).get();
 }
 
+bool Workspaces::contains(wf::point_t ws) const {
+    return ws.x >= 0 && ws.y >= 0 && ws.x < (int)workspaces.size() &&
+           ws.y < (int)workspaces[ws.x].size();
+}
+
 void Workspaces::for_each(const std::function<void(WorkspaceRef)> &fun) {
     for (auto &col : workspaces)
         for (auto &ws : col)
@@ -1511,6 +2515,28 @@ WorkspaceRef Swayfire::get_view_workspace(wayfire_view view,
     return workspaces.get(wsid);
 }
 
+void Swayfire::prefetch_layouts() {
+    const auto curr = output->workspace->get_current_workspace();
+
+    std::vector<wf::point_t> targets = {
+        {curr.x - 1, curr.y},
+        {curr.x + 1, curr.y},
+        {curr.x, curr.y - 1},
+        {curr.x, curr.y + 1},
+    };
+    if (previous_wsid)
+        targets.push_back(*previous_wsid);
+
+    for (const auto wsid : targets)
+        if (workspaces.contains(wsid))
+            workspaces.get(wsid)->flush_pending_layout();
+}
+
+void Swayfire::schedule_layout_prefetch() {
+    if (!idle_prefetch.is_connected())
+        idle_prefetch.run_once([&]() { prefetch_layouts(); });
+}
+
 std::unique_ptr<ViewNode> Swayfire::init_view_node(wayfire_view view) {
     auto node = std::make_unique<ViewNode>(view);
     view->store_data<ViewData>(std::make_unique<ViewData>(node));
@@ -1529,14 +2555,8 @@ void Swayfire::correct_view_workspace(ViewNodeRef node,
             to_ws->insert_floating_node(
                 from_ws->remove_floating_node(floating));
 
-            // Sticky views don't get moved on workspace change, so
-            // their local coords are already right.
-            if (!node->view->sticky)
-                floating->set_geometry(nonwf::local_to_relative_geometry(
-                    floating->get_geometry(), from_ws->wsid, to_ws->wsid,
-                    output));
-            else
-                floating->refresh_geometry();
+            floating->set_geometry(nonwf::local_to_relative_geometry(
+                floating->get_geometry(), from_ws->wsid, to_ws->wsid, output));
         }
     }
 }
@@ -1548,11 +2568,17 @@ void Swayfire::bind_signals() {
     output->connect(&on_view_attached);
     output->connect(&on_view_minimized);
     output->connect(&on_view_change_workspace);
+    output->connect(&on_view_set_sticky);
+    output->connect(&on_workspace_change_request);
     output->connect(&on_workspace_changed);
+    wf::get_core().connect(&on_view_pre_moved_to_output);
 }
 
 void Swayfire::unbind_signals() {
+    wf::get_core().disconnect(&on_view_pre_moved_to_output);
     output->disconnect(&on_workspace_changed);
+    output->disconnect(&on_workspace_change_request);
+    output->disconnect(&on_view_set_sticky);
     output->disconnect(&on_view_change_workspace);
     output->disconnect(&on_view_minimized);
     output->disconnect(&on_view_attached);
@@ -1569,22 +2595,57 @@ void Swayfire::init() {
     auto grid_dims = output->workspace->get_workspace_grid_size();
 
     workspaces.update_dims(grid_dims, output->workspace->get_workarea(), this);
+    sticky.init(output, get_current_workspace());
+
+    // Rebuild the layouts left by the last instance unloaded on this output,
+    // or the ones it had when it was removed, if any, in a single layout pass
+    // per workspace. The views get their old geometries back so they are not
+    // reconfigured.
+    auto handoff = take_layout_handoff();
+    auto detached = reclaim_detached_layouts();
+    if (handoff.empty())
+        handoff = std::move(detached);
+
+    // Views moved back from other outputs don't have a geometry on the right
+    // workspace yet: place the views of the snapshots by snapshot.
+    std::unordered_map<std::uint32_t, wf::point_t> snap_wsids;
+    for (const auto &snap : handoff)
+        for (const auto &record : snap.records)
+            if (!(record.flags & LayoutRecord::SPLIT) &&
+                workspaces.contains(snap.wsid))
+                snap_wsids[record.view_id] = snap.wsid;
+
+    const auto get_wsid = [&](wayfire_view view) {
+        auto it = snap_wsids.find(view->get_id());
+        return it == snap_wsids.end() ? nonwf::get_view_workspace(view)
+                                      : it->second;
+    };
 
     auto views = output->workspace->get_views_in_layer(wf::ALL_LAYERS);
 
-    for (auto view : views) {
-        if (view->role == wf::VIEW_ROLE_TOPLEVEL) {
-            auto ws = workspaces.get(nonwf::get_view_workspace(view));
-            ws->insert_tiled_node(init_view_node(view));
-        }
-    }
+    workspaces.for_each([&](WorkspaceRef ws) {
+        ws->batch_layout([&]() {
+            for (auto view : views)
+                if (view->role == wf::VIEW_ROLE_TOPLEVEL &&
+                    get_wsid(view) == ws->wsid)
+                    ws->insert_tiled_node(init_view_node(view));
+
+            for (const auto &snap : handoff)
+                if (snap.wsid == ws->wsid)
+                    ws->restore_layout(snap);
+        });
+    });
 
     if (auto active_view = output->get_active_view())
         if (auto node = get_view_node(active_view))
             node->set_active();
 
+    recorder::install_crash_handlers();
     init_grab_interface();
 
+    rules.compile(window_rules);
+    window_rules.set_callback([&]() { rules.compile(window_rules); });
+
     bind_signals();
     bind_activators();
 
@@ -1605,13 +2666,25 @@ void Swayfire::fini() {
     unbind_signals();
 
     fini_grab_interface();
+    recorder::uninstall_crash_handlers();
+
+    idle_graft.disconnect();
 
     if (!is_shutting_down()) {
+        // There is no telling an output removal from an unload here: do both.
+        save_layout_handoff();
+        save_detached_layouts();
+
         // Destroy all workspaces, which will destroy all managed nodes and
-        // detach custom data from the managed views.
+        // detach custom data from the managed views. Sticky nodes report to
+        // a ws so they go first.
+        sticky.fini();
         workspaces.workspaces.clear();
     }
 
+    // Tearing down the trees may have scheduled a prefetch.
+    idle_prefetch.disconnect();
+
     output->workspace->set_workspace_implementation(nullptr, true);
 }
 
@@ -2,11 +2,17 @@
 #define SWAYFIRE_CORE_HPP
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <optional>
+#include <regex>
+#include <string>
 #include <sys/types.h>
+#include <unordered_map>
 #include <vector>
 
 #include <wayfire/config/types.hpp>
@@ -21,16 +27,26 @@
 #define WAYFIRE_PER_OUTPUT
 #include <wayfire/per-output-plugin.hpp>
 #endif
+#include <wayfire/render-manager.hpp>
 #include <wayfire/signal-definitions.hpp>
+#include <wayfire/util.hpp>
 #include <wayfire/util/log.hpp>
 #include <wayfire/view-transform.hpp>
 #include <wayfire/workspace-manager.hpp>
 
+#include "recorder.hpp"
 #include "signals.hpp"
 
 constexpr std::uint32_t FLOATING_MOVE_STEP = 5;
+
+/// Maximum speed in px/s of keyboard-driven floating moves.
+constexpr double FLOATING_MOVE_MAX_SPEED = 4000;
 constexpr std::int32_t MIN_VIEW_SIZE = 20;
 
+/// Time in ms after which a client that didn't commit the last configured size
+/// is considered to have acked it anyway.
+constexpr std::uint32_t CONFIGURE_ACK_TIMEOUT = 200;
+
 using OutputRef = nonstd::observer_ptr<wf::output_t>;
 
 /// Small wayfire helpers.
@@ -200,12 +216,22 @@ class INodeParent : public virtual IDisplay {
 
     /// Notify this parent that a direct child has changed its title.
     virtual void notify_child_title_changed(Node child) { (void)child; }
+
+    /// Notify this parent that the amount of urgent views under a direct child
+    /// changed by delta.
+    virtual void notify_child_urgency_changed(Node child, std::int32_t delta) {
+        (void)child;
+        (void)delta;
+    }
+
+    /// Notify this parent that the size constraints of a direct child changed.
+    virtual void notify_child_constraints_changed(Node child) { (void)child; }
 };
 
 using NodeParent = nonstd::observer_ptr<INodeParent>;
 
-/// Id counter for generating node ids
-static uint id_counter;
+/// Id counter for generating node ids, shared by all translation units.
+inline uint id_counter = 0;
 
 class Swayfire;
 
@@ -258,6 +284,81 @@ struct Padding {
     }
 };
 
+/// The maximum size of nodes that can grow without bounds.
+constexpr std::int32_t UNBOUNDED_SIZE = 1 << 24;
+
+/// The limits of the outer dimensions of a node.
+struct SizeConstraints {
+    wf::dimensions_t min{MIN_VIEW_SIZE, MIN_VIEW_SIZE};   ///< Minimum size.
+    wf::dimensions_t max{UNBOUNDED_SIZE, UNBOUNDED_SIZE}; ///< Maximum size.
+
+    /// Get the minimum width if horizontal, else the minimum height.
+    [[nodiscard]] std::int32_t get_min(bool horizontal) const {
+        return horizontal ? min.width : min.height;
+    }
+
+    /// Get the maximum width if horizontal, else the maximum height.
+    [[nodiscard]] std::int32_t get_max(bool horizontal) const {
+        return horizontal ? max.width : max.height;
+    }
+
+    /// Clamp the given dimensions within the constraints.
+    [[nodiscard]] wf::dimensions_t clamp(wf::dimensions_t dims) const {
+        return {
+            std::clamp(dims.width, min.width, max.width),
+            std::clamp(dims.height, min.height, max.height),
+        };
+    }
+
+    friend bool operator==(const SizeConstraints &a,
+                           const SizeConstraints &b) {
+        return a.min.width == b.min.width && a.min.height == b.min.height &&
+               a.max.width == b.max.width && a.max.height == b.max.height;
+    }
+
+    friend bool operator!=(const SizeConstraints &a,
+                           const SizeConstraints &b) {
+        return !(a == b);
+    }
+};
+
+/// Counters of the work done on an output, shown by the performance HUD.
+///
+/// Counters are only maintained while enabled, so that they cost a branch
+/// otherwise.
+struct PerfCounters {
+    using Clock = std::chrono::steady_clock;
+
+    /// Whether the counters are maintained.
+    bool enabled = false;
+
+    Clock::duration layout_time{};     ///< Time spent in layout passes.
+    Clock::duration max_layout_time{}; ///< Duration of the longest pass.
+    std::uint32_t layout_passes = 0;   ///< Amount of layout passes.
+    std::uint32_t configures = 0;      ///< Configures sent to clients.
+    std::uint32_t texture_uploads = 0; ///< Decoration textures uploaded.
+    std::uint32_t draw_calls = 0;      ///< Decoration render passes.
+
+    /// Run a layout pass, timing it if enabled.
+    template <class F> void time_layout(F &&pass) {
+        if (!enabled) {
+            pass();
+            return;
+        }
+
+        const auto start = Clock::now();
+        pass();
+        const auto elapsed = Clock::now() - start;
+
+        layout_time += elapsed;
+        max_layout_time = std::max(max_layout_time, elapsed);
+        layout_passes++;
+    }
+
+    /// Reset the counters, keeping them enabled or not.
+    void reset() { *this = PerfCounters{enabled}; }
+};
+
 /// Interface for common functionality of nodes.
 class INode : public virtual IDisplay, public wf::object_base_t, public wf::signal::provider_t {
   protected:
@@ -288,6 +389,13 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
     uint pure_set_geo = 0; ///< If non-zero, disables side-effects of
                            ///< set_geometry().
 
+    /// Whether the geometry was only recorded while the node was hidden and
+    /// still has to be applied.
+    bool geometry_pending = false;
+
+    /// Whether this node is hidden by a stack ancestor.
+    bool hidden = false;
+
     /// Views attached to this node. Equivalent of view subsurfaces, but for
     /// nodes.
     std::vector<wayfire_view> subsurfaces;
@@ -304,6 +412,25 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
     /// Emit the "title-changed" signal and propagate it to the parent nodes.
     void emit_title_changed();
 
+    /// The amount of urgent views in the subtree of this node.
+    std::uint32_t urgent_count = 0;
+
+    /// Add delta to the urgent count of this node and propagate it to the
+    /// parent nodes.
+    void add_urgent_count(std::int32_t delta);
+
+    /// The size constraints of the subtree of this node, kept up to date
+    /// incrementally.
+    SizeConstraints constraints{};
+
+    /// Compute the size constraints of this node from its direct children or
+    /// its client.
+    virtual SizeConstraints compute_constraints() = 0;
+
+    /// Recompute the size constraints of this node and propagate them to the
+    /// parent nodes if they changed.
+    void update_constraints();
+
     INode() : node_id(id_counter) { id_counter++; }
 
   public:
@@ -322,6 +449,22 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
     /// Dynamic cast to ViewNodeRef.
     ViewNodeRef as_view_node();
 
+    /// Get the unique id of this node.
+    [[nodiscard]] uint get_id() const { return node_id; }
+
+    /// Get the amount of urgent views in the subtree of this node.
+    [[nodiscard]] std::uint32_t get_urgent_count() const {
+        return urgent_count;
+    }
+
+    /// Whether a view in the subtree of this node demands attention.
+    [[nodiscard]] bool is_urgent() const { return urgent_count > 0; }
+
+    /// Get the size constraints of the subtree of this node.
+    [[nodiscard]] const SizeConstraints &get_constraints() const {
+        return constraints;
+    }
+
     /// Notify the node that it has been initialized.
     ///
     /// Noop if node is already initialized
@@ -358,6 +501,23 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
         pure_set_geo--;
     }
 
+    /// Record the outer geometry of a hidden node without applying it.
+    ///
+    /// The geometry is applied by the next set_geometry() or by
+    /// flush_pending_geometry() once the node is visible again.
+    void set_geometry_deferred(wf::geometry_t geo) {
+        ref_pure_set_geo();
+        set_geometry(geo);
+        unref_pure_set_geo();
+        geometry_pending = true;
+    }
+
+    /// Apply the geometry recorded by set_geometry_deferred() if any.
+    void flush_pending_geometry() {
+        if (geometry_pending)
+            refresh_geometry();
+    }
+
     /// Add the given padding to this node.
     ///
     /// Add negative padding to remove from the current padding.
@@ -398,14 +558,14 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
     /// Set whether this node is floating.
     virtual void set_floating(bool fl);
 
+    /// Set the geometry this node gets the next time it becomes floating.
+    void set_floating_geometry(wf::geometry_t geo) { floating_geometry = geo; }
+
     /// Get the workspace that manages this node.
     WorkspaceRef get_ws() { return ws; };
 
     /// Set the workspace that manages this node.
-    virtual void set_ws(WorkspaceRef ws) {
-        assert(ws);
-        this->ws = ws;
-    };
+    virtual void set_ws(WorkspaceRef ws);
 
     /// Set the sublayer of views in the subtree starting at this node.
     virtual void set_sublayer(nonstd::observer_ptr<wf::scene::floating_inner_ptr> sublayer);
@@ -419,6 +579,18 @@ class INode : public virtual IDisplay, public wf::object_base_t, public wf::sign
     /// Handle this node being made the active node of its workspace.
     virtual void on_set_active() {}
 
+    /// Get whether this node is hidden by a stack ancestor.
+    [[nodiscard]] bool is_hidden() const { return hidden; }
+
+    /// Set whether this node is hidden.
+    ///
+    /// Hidden nodes are disabled in the scenegraph: they are neither rendered
+    /// nor receive input and their clients stop receiving frame callbacks.
+    void set_hidden(bool h);
+
+    /// Handle the hidden state of this node having changed.
+    virtual void on_set_hidden() {}
+
     /// Try to (un)tile this node in its workspace.
     void tile_request(bool tile);
 
@@ -462,11 +634,47 @@ class ViewGeoEnforcer final : public wf::scene::view_2d_transformer_t {
     /// Reference counted geo_enforcer disable switch.
     uint disabled = 0;
 
+    /// A running layout animation.
+    struct Animation {
+        wf::geometry_t from; ///< The ws-local inner geometry animated from.
+        wf::geometry_t to;   ///< The ws-local inner geometry animated to.
+        std::chrono::steady_clock::time_point start; ///< Start time.
+        std::chrono::milliseconds duration;          ///< Total duration.
+        OutputRef output; ///< The output whose frames drive the animation.
+    };
+
+    /// The running layout animation, if any.
+    std::optional<Animation> animation;
+
+    /// The ws-local inner geometry the buffer is currently stretched over.
+    std::optional<wf::geometry_t> displayed_geo;
+
+    /// The wsid displayed_geo is local to.
+    wf::point_t displayed_wsid{0, 0};
+
+    /// Advance the animation right before the frame is rendered.
+    wf::effect_hook_t on_frame = [&]() { step_animation(); };
+
     /// Handle the view changing geometry.
     wf::signal::connection_t<GeometryChangedSignalData> on_geometry_changed = [&](GeometryChangedSignalData *) {
         update_transformer();
     };
 
+    /// Whether a change of the node geometry should be animated.
+    [[nodiscard]] bool should_animate() const;
+
+    /// Start animating the displayed geometry between the two geometries.
+    void start_animation(wf::geometry_t from, wf::geometry_t to);
+
+    /// Stop the running animation, if any.
+    void stop_animation();
+
+    /// Advance the running animation to the current time.
+    void step_animation();
+
+    /// Stretch the current buffer over displayed_geo.
+    void enforce();
+
   public:
     ViewGeoEnforcer(ViewNodeRef node);
 
@@ -481,9 +689,71 @@ class ViewGeoEnforcer final : public wf::scene::view_2d_transformer_t {
 
     /// Update the scaling and offset to enforce the geometry.
     void update_transformer();
+
+    /// Whether the buffer is currently stretched to a size it wasn't drawn at.
+    [[nodiscard]] bool is_stretching() const {
+        return scale_x != 1 || scale_y != 1;
+    }
 };
 
 struct ViewData;
+class MruList;
+
+/// The links of a view node in an intrusive MruList.
+struct MruHook {
+    ViewNodeRef prev = nullptr; ///< The next more recently used node.
+    ViewNodeRef next = nullptr; ///< The next less recently used node.
+    nonstd::observer_ptr<MruList> list = nullptr; ///< The list linked in.
+};
+
+/// Intrusive most-recently-used list of view nodes.
+///
+/// The links live in the nodes themselves, so all updates are O(1) and never
+/// allocate.
+class MruList {
+  private:
+    /// The hook of the nodes used by this list.
+    MruHook ViewNode::*hook;
+
+    ViewNodeRef head = nullptr; ///< The most recently used node.
+    ViewNodeRef tail = nullptr; ///< The least recently used node.
+
+    /// Get the hook of node used by this list.
+    MruHook &hook_of(ViewNodeRef node) const;
+
+  public:
+    explicit MruList(MruHook ViewNode::*hook) : hook(hook) {}
+    MruList(const MruList &) = delete;
+    MruList &operator=(const MruList &) = delete;
+
+    /// Unlink all the nodes.
+    ~MruList();
+
+    /// Move node to the front of the list, linking it if needed.
+    void touch(ViewNodeRef node);
+
+    /// Unlink node if it is linked in this list.
+    void remove(ViewNodeRef node);
+
+    /// Whether node is linked in this list.
+    [[nodiscard]] bool contains(ViewNodeRef node) const;
+
+    /// Get the most recently used node.
+    [[nodiscard]] ViewNodeRef front() const { return head; }
+
+    /// Get the node used right before node, or nullptr.
+    [[nodiscard]] ViewNodeRef next(ViewNodeRef node) const;
+
+    /// Get the node used right after node, or nullptr.
+    [[nodiscard]] ViewNodeRef prev(ViewNodeRef node) const;
+
+    /// Get the least recently used node.
+    [[nodiscard]] ViewNodeRef back() const { return tail; }
+
+    /// The node a focus cycle through this list is at. Cleared when it gets
+    /// unlinked.
+    ViewNodeRef cursor = nullptr;
+};
 
 /// A node corresponding to a wayfire view.
 class ViewNode final : public INode {
@@ -503,8 +773,19 @@ class ViewNode final : public INode {
     wf::signal::connection_t<wf::view_mapped_signal> on_mapped = [&](wf::view_mapped_signal *) {
         if (view->tiled_edges != wf::TILED_EDGES_ALL)
             floating_geometry = expand_geometry(view->get_wm_geometry());
+        connect_size_hints();
     };
 
+    /// Handle the client committing its surface, possibly with new size
+    /// hints.
+    wf::wl_listener_wrapper on_commit;
+
+    /// Handle an XWayland client setting new hints.
+    wf::wl_listener_wrapper on_xwayland_set_hints;
+
+    /// Listen for size hint changes on the current surface of the view.
+    void connect_size_hints();
+
     /// Handle unmapped views.
     wf::signal::connection_t<wf::view_unmapped_signal> on_unmapped = [&](wf::view_unmapped_signal *) {
         // can't inline it here since depends on ws methods.
@@ -521,6 +802,16 @@ class ViewNode final : public INode {
         emit_title_changed();
     };
 
+    /// Handle the view demanding attention or not anymore.
+    wf::signal::connection_t<wf::view_hints_changed_signal> on_hints_changed =
+        [&](wf::view_hints_changed_signal *data) {
+            // The focused view already has the user's attention.
+            set_urgent(data->demands_attention && !view->activated);
+        };
+
+    /// Set whether the view demands attention.
+    void set_urgent(bool urgent);
+
     /// Destroys the view node and the custom data attached to the view.
     void on_unmapped_impl();
 
@@ -545,6 +836,40 @@ class ViewNode final : public INode {
     /// Whether the node is fullscreened.
     bool fullscreen = false;
 
+    /// The geo enforcer transformer, kept alive while detached from the view.
+    std::shared_ptr<ViewGeoEnforcer> enforcer_transformer;
+
+    /// The size last sent to the client.
+    wf::dimensions_t configured_size{0, 0};
+
+    /// The latest geometry to send once the client acks its outstanding
+    /// configure.
+    std::optional<wf::geometry_t> queued_configure;
+
+    /// Armed while a configure is outstanding.
+    wf::wl_timer<false> configure_timeout;
+
+    /// When the outstanding configure was sent, if the perf counters were
+    /// enabled then.
+    std::optional<PerfCounters::Clock::time_point> configure_sent;
+
+    /// Time the client took to ack its last configure, as measured while
+    /// the perf counters were enabled.
+    PerfCounters::Clock::duration ack_latency{};
+
+    /// Send the given inner geometry to the view.
+    ///
+    /// While the client hasn't acked a previous resize, further resizes are
+    /// collapsed into a single queued one.
+    void configure_view(wf::geometry_t inner);
+
+    /// Shrink or grow the given inner geometry to the closest size the client
+    /// accepts according to its size hints, keeping its position.
+    wf::geometry_t constrain_inner_geometry(wf::geometry_t inner);
+
+    /// Handle the outstanding configure being acked, sending the queued one.
+    void on_configure_acked();
+
   public:
     /// The wayfire view corresponding to this node.
     wayfire_view view;
@@ -552,6 +877,12 @@ class ViewNode final : public INode {
     /// The geo enforcer transformer attached to the view.
     nonstd::observer_ptr<ViewGeoEnforcer> geo_enforcer;
 
+    /// The links of this node in the focus history of its workspace.
+    MruHook ws_mru_hook;
+
+    /// The links of this node in the focus history of its output.
+    MruHook output_mru_hook;
+
     ViewNode(wayfire_view view);
 
     ~ViewNode() override;
@@ -570,11 +901,18 @@ class ViewNode final : public INode {
     /// Set the prefered_split_type of this view node.
     void set_prefered_split_type(std::optional<SplitType> split_type);
 
+    /// Get the time the client took to ack its last configure, or has been
+    /// taking to ack its outstanding one if longer.
+    [[nodiscard]] PerfCounters::Clock::duration get_ack_latency() const;
+
     /// Get whether the node is fullscreened.
     bool is_fullscreen() { return fullscreen; }
 
     /// Set whether the node is fullscreened.
-    void set_fullscreen(bool f) { fullscreen = f; }
+    ///
+    /// A fullscreen view is left alone in the scene of its ws, without the geo
+    /// enforcer transformer, so that it can be scanned out directly.
+    void set_fullscreen(bool f);
 
     // == INode impl ==
 
@@ -582,11 +920,14 @@ class ViewNode final : public INode {
     std::string get_title() override;
     void set_geometry(wf::geometry_t geo) override;
     void set_floating(bool fl) override;
+    void set_ws(WorkspaceRef ws) override;
     void set_sublayer(nonstd::observer_ptr<wf::scene::floating_inner_ptr> sublayer) override;
     void bring_to_front() override;
     void on_set_active() override;
+    void on_set_hidden() override;
     NodeParent get_or_upgrade_to_parent_node() override;
     void for_each_node(const std::function<void(Node)> &f) override;
+    SizeConstraints compute_constraints() override;
 
     // == IDisplay impl ==
 
@@ -704,6 +1045,17 @@ class SplitNode final : public INode, public INodeParent {
         return children.at(i).node.get();
     }
 
+    /// Return whether node is a direct child of this split.
+    [[nodiscard]] bool has_child(Node node) {
+        return find_child(node) != children.end();
+    }
+
+    /// Lay out the children in the current geometry of this split.
+    ///
+    /// Unlike set_geometry(), this has no side effect of its own, even out of
+    /// pure set_geometry() mode.
+    void layout_children();
+
     /// Return whether this is a v/h-split.
     bool is_split() {
         return split_type == SplitType::VSPLIT ||
@@ -734,12 +1086,23 @@ class SplitNode final : public INode, public INodeParent {
     /// Remove a direct child from the given position in children.
     OwnedNode remove_child_at(SplitChildIter child);
 
+    /// Get the size ratios of the direct children.
+    [[nodiscard]] std::vector<double> get_ratios() const;
+
+    /// Set the size ratios of the direct children.
+    ///
+    /// The ratios are normalized so that they add up to 1.
+    void set_ratios(const std::vector<double> &ratios);
+
     /// Get the split type of this node.
     SplitType get_split_type() { return split_type; }
 
     /// Set the split type of this node.
     void set_split_type(SplitType st);
 
+    /// Hide all children but the active one if this is a stack.
+    void refresh_children_hidden();
+
     /// Try to downgrade this node to its only child node.
     ///
     /// A split node is only downgradable if it contains exactly one direct
@@ -762,6 +1125,8 @@ class SplitNode final : public INode, public INodeParent {
     void set_active_child(Node node) override;
     Node get_active_child() const override;
     void notify_child_title_changed(Node child) override;
+    void notify_child_urgency_changed(Node child, std::int32_t delta) override;
+    void notify_child_constraints_changed(Node child) override;
 
     // == INode impl ==
 
@@ -773,8 +1138,10 @@ class SplitNode final : public INode, public INodeParent {
     void set_sublayer(nonstd::observer_ptr<wf::scene::floating_inner_ptr> sublayer) override;
     void bring_to_front() override;
     void set_ws(WorkspaceRef ws) override;
+    void on_set_hidden() override;
     NodeParent get_or_upgrade_to_parent_node() override;
     void for_each_node(const std::function<void(Node)> &f) override;
+    SizeConstraints compute_constraints() override;
 
     // == IDisplay impl ==
 
@@ -784,6 +1151,141 @@ class SplitNode final : public INode, public INodeParent {
     }
 };
 
+/// A compact record of a node in a layout snapshot.
+///
+/// Records are stored in pre-order: the record of a split is directly followed
+/// by the records of its children.
+struct LayoutRecord {
+    enum Flags : std::uint8_t {
+        SPLIT = 1 << 0,        ///< The node is a split node.
+        FLOATING = 1 << 1,     ///< The node is a floating root.
+        ACTIVE_CHILD = 1 << 2, ///< The node is the active child of its parent.
+        WAS_VSPLIT = 1 << 3,   ///< The split was last a vsplit.
+    };
+
+    std::uint32_t view_id = 0;     ///< The id of the view of a view node.
+    std::uint32_t child_count = 0; ///< The amount of children of a split.
+    double ratio = 1.0;            ///< The size ratio in the parent split.
+    wf::geometry_t floating_geo{}; ///< The geometry of a floating root.
+    SplitType split_type = SplitType::VSPLIT; ///< The type of a split.
+    std::uint8_t flags = 0;                   ///< Combination of Flags.
+
+    friend bool operator==(const LayoutRecord &a, const LayoutRecord &b) {
+        return a.view_id == b.view_id && a.child_count == b.child_count &&
+               a.ratio == b.ratio && a.floating_geo == b.floating_geo &&
+               a.split_type == b.split_type && a.flags == b.flags;
+    }
+};
+
+/// A snapshot of the layout of a workspace.
+struct LayoutSnapshot {
+    wf::point_t wsid;                 ///< The workspace of the layout.
+    std::uint32_t active_view_id = 0; ///< The view of the active node.
+
+    /// The tiled tree records followed by the floating trees records.
+    std::vector<LayoutRecord> records;
+
+    /// Whether the snapshots are of the same layout, whatever node is active.
+    [[nodiscard]] bool same_layout(const LayoutSnapshot &other) const {
+        return wsid == other.wsid && records == other.records;
+    }
+};
+
+/// View nodes taken out of their trees while rebuilding a layout, by view id.
+using ViewNodePool = std::unordered_map<std::uint32_t, OwnedNode>;
+
+/// Bounded undo/redo history of the layouts of a workspace.
+///
+/// Undoing a mutation restores the layout from before it, so the snapshots
+/// act as the inverse of the recorded mutations.
+class LayoutHistory {
+  private:
+    std::deque<LayoutSnapshot> undo_stack; ///< Layouts to undo to.
+    std::deque<LayoutSnapshot> redo_stack; ///< Layouts to redo to.
+
+    /// Push a snapshot dropping the oldest ones beyond capacity.
+    static void push(std::deque<LayoutSnapshot> &stack, LayoutSnapshot snap,
+                     std::size_t capacity);
+
+  public:
+    /// Record the layout from before a mutation and clear the redo history.
+    void record(LayoutSnapshot snap, std::size_t capacity);
+
+    /// Push a layout to undo to without clearing the redo history.
+    void push_undo(LayoutSnapshot snap, std::size_t capacity);
+
+    /// Push a layout to redo to.
+    void push_redo(LayoutSnapshot snap, std::size_t capacity);
+
+    /// Pop the latest layout to undo to.
+    std::optional<LayoutSnapshot> pop_undo();
+
+    /// Pop the latest layout to redo to.
+    std::optional<LayoutSnapshot> pop_redo();
+};
+
+/// The layouts of an output handed over by an unloaded swayfire instance to
+/// the next one loaded on the output.
+struct LayoutHandoff : public wf::custom_data_t {
+    /// The layouts of the workspaces. The sticky nodes are part of the layout
+    /// of the workspace that was current.
+    std::vector<LayoutSnapshot> layouts;
+};
+
+/// The placement applied by window rules to a view when it is attached.
+struct RuleActions {
+    std::optional<wf::point_t> wsid;      ///< The workspace to place it on.
+    std::optional<bool> floating;         ///< Whether it is floating.
+    std::optional<wf::dimensions_t> size; ///< Its floating size.
+    std::optional<SplitType> layout;      ///< The split type of its parent.
+    std::optional<SplitType> split;       ///< Its prefered split type.
+
+    /// Override the actions set in this with the ones set in other.
+    void merge(const RuleActions &other);
+};
+
+/// Marks the views the window rules were applied to.
+struct RulesAppliedData : wf::custom_data_t {};
+
+/// A sway-style window rule: criteria and the actions applied on matching
+/// views.
+struct WindowRule {
+    /// The app_id the rule matches exactly, when its pattern is a literal.
+    std::optional<std::string> app_id_literal;
+
+    std::optional<std::regex> app_id;       ///< app_id criterion.
+    std::optional<std::regex> title;        ///< title criterion.
+    std::optional<std::regex> window_class; ///< class criterion (X11 only).
+    std::optional<std::regex> window_role;  ///< window_role criterion (X11).
+
+    RuleActions actions; ///< What to do with matching views.
+};
+
+/// The window rules compiled once at config load.
+///
+/// Rules matching a literal app_id are indexed by it, so that matching a view
+/// only tests the rules that can apply to it.
+class WindowRules {
+  private:
+    /// All the rules, in config order.
+    std::vector<WindowRule> rules;
+
+    /// Indices into rules of the rules with a literal app_id, by app_id.
+    std::unordered_map<std::string, std::vector<std::size_t>> by_app_id;
+
+    /// Indices into rules of the rules without a literal app_id.
+    std::vector<std::size_t> generic;
+
+  public:
+    /// Parse and compile the given rules, replacing the current ones.
+    ///
+    /// Invalid rules are logged and skipped.
+    void compile(const wf::config::compound_list_t<std::string> &sources);
+
+    /// Get the merged actions of all the rules matching view, in order.
+    [[nodiscard]] RuleActions match(wayfire_view view) const;
+};
+
 /// A single workspace managing a tiled tree and floating nodes.
 class Workspace final : public INodeParent {
   private:
@@ -797,6 +1299,9 @@ class Workspace final : public INodeParent {
     };
 
   public:
+    /// Undo/redo history of the layouts of this ws.
+    LayoutHistory history;
+
     /// The workarea of this ws.
     ///
     /// The workarea is the output size minus space reserves for panels and
@@ -812,6 +1317,9 @@ class Workspace final : public INodeParent {
     /// The sublayer which holds all floating nodes in this workspace.
     nonstd::observer_ptr<wf::scene::floating_inner_ptr> floating_sublayer;
 
+    /// The sublayer which holds the fullscreen view of this workspace alone.
+    nonstd::observer_ptr<wf::scene::floating_inner_ptr> fullscreen_sublayer;
+
     /// The floating nodes that are manages by this ws.
     ///
     /// All floating nodes are direct children of their workspace.
@@ -820,6 +1328,9 @@ class Workspace final : public INodeParent {
     /// The Swayfire plugin that owns this workspace.
     nonstd::observer_ptr<Swayfire> plugin;
 
+    /// The focus history of the view nodes of this ws.
+    MruList mru{&ViewNode::ws_mru_hook};
+
     /// The wayfire output that this workspace is on.
     OutputRef output;
 
@@ -829,6 +1340,9 @@ class Workspace final : public INodeParent {
     /// Reference to the node currently active in this ws.
     Node active_node = nullptr;
 
+    /// The fullscreen node hiding everything else in this ws, if any.
+    ViewNodeRef fullscreen_node = nullptr;
+
     /// The last active floating node index.
     std::uint32_t active_floating = 0;
 
@@ -843,6 +1357,35 @@ class Workspace final : public INodeParent {
     /// Reset the active node to the next valid node in the ws
     void reset_active_node();
 
+    /// Whether node is in the tree of this ws.
+    [[nodiscard]] bool is_attached(ViewNodeRef node);
+
+    /// Rebuild the floating trees of a snapshot, from its record i on, from
+    /// the view nodes in pool, placing them at map_geo of their recorded
+    /// geometry.
+    void restore_floating(const LayoutSnapshot &snap, std::size_t i,
+                          ViewNodePool &pool,
+                          const std::function<wf::geometry_t(wf::geometry_t)>
+                              &map_geo);
+
+    /// Nesting depth of batch_layout() calls.
+    std::uint32_t layout_batch_depth = 0;
+
+    /// Whether layout changes were deferred while this ws was not visible.
+    bool layout_pending = false;
+
+    /// Whether the deferred layout changes are being applied.
+    bool flushing_layout = false;
+
+    /// The amount of urgent views in this ws.
+    std::uint32_t urgent_count = 0;
+
+    /// Add delta to the urgent count of this ws.
+    void add_urgent_count(std::int32_t delta);
+
+    // The sticky nodes count as urgent views of the current ws.
+    friend class StickyLayer;
+
   public:
     Workspace(wf::point_t wsid, wf::geometry_t geo,
               nonstd::observer_ptr<Swayfire> swayfire);
@@ -861,14 +1404,49 @@ class Workspace final : public INodeParent {
     Node get_active_node();
 
     /// Set the workarea of the workspace.
+    ///
+    /// The relayout is deferred if this ws is not visible.
     void set_workarea(wf::geometry_t geo);
 
+    /// Return whether this ws is the current workspace of its output.
+    [[nodiscard]] bool is_visible() const;
+
+    /// Return whether layout side-effects are deferred until this ws becomes
+    /// visible.
+    [[nodiscard]] bool is_deferring_layout() const {
+        return !flushing_layout && !is_visible();
+    }
+
+    /// Note that a layout change was deferred.
+    void mark_layout_pending();
+
+    /// Apply the layout changes deferred while this ws was not visible.
+    void flush_pending_layout();
+
     /// Get the workarea of the workspace.
     wf::geometry_t get_workarea() { return workarea; }
 
+    /// Get the amount of urgent views in this ws.
+    [[nodiscard]] std::uint32_t get_urgent_count() const {
+        return urgent_count;
+    }
+
+    void notify_child_urgency_changed(Node child, std::int32_t delta) override;
+
     /// Get the sublayer of the direct child of this workspace.
     nonstd::observer_ptr<wf::scene::floating_inner_ptr> get_child_sublayer(Node child);
 
+    /// Get the fullscreen node hiding everything else in this ws, if any.
+    [[nodiscard]] ViewNodeRef get_fullscreen_node() const {
+        return fullscreen_node;
+    }
+
+    /// Set the fullscreen node of this ws, or unset it with nullptr.
+    ///
+    /// The view of the node is moved to a sublayer of its own and all the other
+    /// swayfire-owned surfaces of this ws are disabled in the scenegraph.
+    void set_fullscreen_node(ViewNodeRef node);
+
     // == Floating ==
 
     /// Insert a floating node into this workspace.
@@ -918,6 +1496,44 @@ class Workspace final : public INodeParent {
     /// Apply function to all nodes in this workspace.
     void for_each_node(const std::function<void(Node)> &f);
 
+    /// Apply a series of tree mutations as a single layout update.
+    ///
+    /// While f runs, tiled view nodes only record their new geometries. The
+    /// tiled tree is laid out once at the end, so each client gets at most
+    /// one configure for the whole batch.
+    void batch_layout(const std::function<void()> &f);
+
+    /// Start a layout batch spanning several calls, laid out once
+    /// end_layout_batch() is called. Prefer batch_layout().
+    void begin_layout_batch() { layout_batch_depth++; }
+
+    /// End a batch started by begin_layout_batch().
+    void end_layout_batch();
+
+    /// Return whether a batch_layout() is in progress.
+    [[nodiscard]] bool is_batching_layout() const {
+        return layout_batch_depth != 0;
+    }
+
+    /// Take a snapshot of the layout of this workspace.
+    [[nodiscard]] LayoutSnapshot capture_layout();
+
+    /// Rebuild the layout of this workspace from a snapshot.
+    ///
+    /// Views that are not in the snapshot are tiled at the end of the tiled
+    /// root, views that are no longer in this workspace are skipped. The focus
+    /// only moves if this workspace is visible.
+    void restore_layout(const LayoutSnapshot &snap);
+
+    /// Rebuild the trees of a snapshot taken on another output next to the
+    /// layout of this workspace, from the view nodes in pool.
+    ///
+    /// The tiled tree is inserted as a single child of the tiled root and the
+    /// floating geometries are scaled by (sx, sy). Nodes taken from the pool
+    /// are erased from it.
+    void graft_layout(const LayoutSnapshot &snap, ViewNodePool &pool,
+                      double sx, double sy);
+
     // == INodeParent impl ==
 
     Node get_adjacent(Node node, Direction dir) override;
@@ -940,6 +1556,87 @@ class Workspace final : public INodeParent {
     }
 };
 
+/// The sticky floating nodes of an output.
+///
+/// Sticky nodes are shown on every workspace of the output, so they are owned
+/// by the output rather than by a workspace, in a sublayer of their own.
+/// Switching workspaces only changes which ws they report to: they are never
+/// reparented nor relaid out. Their urgency counts towards that ws.
+///
+/// The sublayer is docked above the floating sublayers of the workspaces, so
+/// sticky views always stack above non-sticky floating views.
+class StickyLayer final : public INodeParent {
+  private:
+    /// The sticky floating root nodes.
+    std::vector<OwnedNode> nodes;
+
+    /// The sublayer holding the views of the sticky nodes.
+    nonstd::observer_ptr<wf::scene::floating_inner_ptr> sublayer = nullptr;
+
+    /// The ws the sticky nodes report to: the current ws of the output.
+    WorkspaceRef ws = nullptr;
+
+    /// The output of this layer.
+    OutputRef output = nullptr;
+
+    /// Get the sum of the urgent counts of the sticky nodes.
+    [[nodiscard]] std::uint32_t get_urgent_count() const;
+
+  public:
+    /// Create the sublayer of the sticky nodes on output.
+    void init(OutputRef output, WorkspaceRef ws);
+
+    /// Destroy all the sticky nodes and the sublayer.
+    void fini();
+
+    /// Whether node is a sticky root node of this layer.
+    [[nodiscard]] bool contains(Node node) const {
+        return node->parent.get() == this;
+    }
+
+    /// Whether node should live in the sticky layer when floating.
+    [[nodiscard]] static bool wants_sticky(Node node);
+
+    /// Get the sticky root nodes.
+    [[nodiscard]] const std::vector<OwnedNode> &get_nodes() const {
+        return nodes;
+    }
+
+    /// Get the sublayer holding the sticky views.
+    [[nodiscard]] nonstd::observer_ptr<wf::scene::floating_inner_ptr>
+    get_sublayer() const {
+        return sublayer;
+    }
+
+    /// Make the sticky nodes report to a new current ws.
+    void set_ws(WorkspaceRef ws);
+
+    /// Hide the sticky nodes while the current ws shows a fullscreen node.
+    void refresh_enabled();
+
+    // == INodeParent impl ==
+
+    Node get_adjacent(Node node, Direction dir) override;
+    bool move_child(Node node, Direction dir) override;
+    wf::dimensions_t try_resize_child(Node child, wf::dimensions_t ndims,
+                                      std::uint32_t edges) override;
+    Node get_last_active_node() override;
+    void insert_child(OwnedNode node) override;
+    OwnedNode remove_child(Node node) override;
+    OwnedNode swap_child(Node node, OwnedNode other) override;
+    void swap_children(Node a, Node b) override;
+    void set_active_child(Node node) override;
+    Node get_active_child() const override;
+    void notify_child_urgency_changed(Node child, std::int32_t delta) override;
+
+    // == IDisplay impl ==
+
+    std::ostream &to_stream(std::ostream &os) const override {
+        os << "sticky-layer";
+        return os;
+    }
+};
+
 /// Grid of all the workspaces on an output.
 class Workspaces {
     friend Swayfire;
@@ -955,6 +1652,9 @@ class Workspaces {
     /// Get the workspace at the given coordinate in the grid.
     WorkspaceRef get(wf::point_t ws);
 
+    /// Check whether the given coordinate is part of the grid.
+    [[nodiscard]] bool contains(wf::point_t ws) const;
+
     /// Iterate through all workspaces in the grid.
     void for_each(const std::function<void(WorkspaceRef)> &fun);
 };
@@ -986,13 +1686,28 @@ inline bool is_shutting_down() {
 class IActiveGrab;
 class IActiveButtonDrag;
 class ActiveMove;
+class ActiveTiledMove;
 class ActiveResize;
+class DragPreview;
 
 class Swayfire final : public wf::per_output_plugin_instance_t {
   public:
     /// The workspaces manages by swayfire.
     Workspaces workspaces;
 
+    /// The focus history of the view nodes of this output.
+    MruList mru{&ViewNode::output_mru_hook};
+
+    /// Whether focus is being cycled through the history, in which case
+    /// focusing doesn't reorder the history of the output.
+    bool mru_cycling = false;
+
+    /// The sticky floating nodes of this output.
+    StickyLayer sticky;
+
+    /// Counters of the work done on this output.
+    PerfCounters perf;
+
   private:
     /// Stores all the activator callbacks bound.
     std::vector<std::unique_ptr<wf::activator_callback>> activator_callbacks;
@@ -1015,6 +1730,19 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
     /// Make a new view_node corresponding to the given view.
     std::unique_ptr<ViewNode> init_view_node(wayfire_view view);
 
+    /// The configured window rules.
+    wf::option_wrapper_t<wf::config::compound_list_t<std::string>>
+        window_rules{"swayfire/window_rules"};
+
+    /// The window rules compiled from window_rules.
+    WindowRules rules;
+
+    /// Make a view node for a new view and place it as the window rules
+    /// matching it say, in a single layout pass.
+    ///
+    /// The rules are only applied the first time a view is attached.
+    void attach_view(wayfire_view view);
+
     /// Initialize gesture grab interfaces and activators.
     void init_grab_interface();
 
@@ -1024,18 +1752,177 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
     /// If necessary, move the view-node to the correct workspace.
     void correct_view_workspace(ViewNodeRef node, wf::point_t correct_ws);
 
+    /// The maximum amount of layouts kept in each of the undo/redo histories.
+    wf::option_wrapper_t<int> history_size{"swayfire/history_size"};
+
+    /// Run a layout mutation on ws, recording the layout from before in the
+    /// history if the mutation returns true.
+    bool record_layout_change(WorkspaceRef ws,
+                              const std::function<bool()> &mutation);
+
+    /// Record the layout from before a finished mutation in the history of
+    /// its workspace. Nothing is recorded if the layout is unchanged.
+    void record_layout(LayoutSnapshot before);
+
+    /// Store the layouts of all the workspaces on the output for the next
+    /// instance loaded.
+    void save_layout_handoff();
+
+    /// Capture the layouts of all the workspaces, sticky nodes included.
+    std::vector<LayoutSnapshot> capture_layouts();
+
+    /// Take the layouts stored on the output by the last instance unloaded.
+    std::vector<LayoutSnapshot> take_layout_handoff();
+
+    /// Remember the layouts of this output by output name, in case the output
+    /// is being removed.
+    void save_detached_layouts();
+
+    /// Move back to this output the views of the layouts it had when it was
+    /// removed, and take these layouts.
+    std::vector<LayoutSnapshot> reclaim_detached_layouts();
+
+    /// Graft the layouts of the removed outputs onto this output, once their
+    /// views were moved here.
+    void graft_detached_layouts();
+
+    /// Graft the layouts of the removed outputs once the views moved here
+    /// are all attached.
+    wf::wl_idle_call idle_graft;
+
+    /// The ws that was current before the current one.
+    std::optional<wf::point_t> previous_wsid;
+
+    /// Prefetch the layouts once the compositor is idle.
+    wf::wl_idle_call idle_prefetch;
+
+    /// Apply the pending layouts of the workspaces likely to be switched to
+    /// next: the grid neighbours of the current ws and the previous ws.
+    ///
+    /// Applying a layout also re-rasterizes the decorations it resizes, so
+    /// switching to these workspaces is left with compositing only.
+    void prefetch_layouts();
+
+    /// Duration in ms of tiling layout animations, 0 to disable them.
+    wf::option_wrapper_t<int> animation_duration{"swayfire/animation_duration"};
+
+    /// Speed in px/s at which keyboard-driven floating moves start.
+    wf::option_wrapper_t<int> floating_move_speed{
+        "swayfire/floating_move_speed"};
+
+    /// Acceleration in px/s² of keyboard-driven floating moves.
+    wf::option_wrapper_t<int> floating_move_acceleration{
+        "swayfire/floating_move_acceleration"};
+
+    friend class ViewGeoEnforcer;
     friend class IActiveGrab;
     friend class IActiveButtonDrag;
     friend class ActiveMove;
+    friend class ActiveTiledMove;
     friend class ActiveResize;
+    friend class DragPreview;
 
     // == Bindings and Binding Callbacks ==
 
-    /// Focus the node in the given direction from the active node.
-    bool focus_direction(Direction dir);
+    /// A directional focus or move command.
+    struct DirectionalCommand {
+        bool move;     ///< Whether to move the active node, else to focus.
+        Direction dir; ///< The direction of the command.
+    };
+
+    /// Whether the effects of directional commands wait for the next frame.
+    bool directional_scheduled = false;
 
-    /// Move the active node in the given direction.
-    bool move_direction(Direction dir);
+    /// The id of the node the directional focus commands since the last
+    /// frame lead to, focused at the next frame.
+    std::optional<uint> directional_focus;
+
+    /// The ws whose layout the directional moves since the last frame are
+    /// batched on, laid out at the next frame.
+    WorkspaceRef directional_batch = nullptr;
+
+    /// The layout of directional_batch before the moves, to undo them as one.
+    std::optional<LayoutSnapshot> directional_before;
+
+    /// Apply the pending effects of the directional commands right before
+    /// the frame is rendered.
+    wf::effect_hook_t on_directional_frame = [&]() { flush_directional(); };
+
+    /// Apply a directional command, returning whether it did anything.
+    ///
+    /// Key repeat bursts are handled as one: the focus hops are resolved
+    /// right away but only the final target is activated at the next frame,
+    /// and the moves are applied right away but laid out once at the next
+    /// frame.
+    bool queue_directional(DirectionalCommand command);
+
+    /// Apply the pending effects of the directional commands at the next
+    /// frame.
+    void schedule_directional();
+
+    /// Apply the pending effects of the directional commands.
+    void flush_directional();
+
+    /// Activate the target of the pending directional focus commands.
+    void apply_directional_focus();
+
+    /// A keyboard-driven motion of a floating node.
+    struct FloatingMotion {
+        uint node_id; ///< The id of the floating root node moved.
+        Node node;    ///< The floating root node moved.
+
+        /// The held keys and the direction each of them moves in.
+        std::unordered_map<std::uint32_t, Direction> keys;
+
+        double speed; ///< The current speed in px/s.
+        double x;     ///< The x position with sub-pixel precision.
+        double y;     ///< The y position with sub-pixel precision.
+
+        /// The position of the node when the motion started.
+        wf::point_t start;
+
+        /// The time of the last step.
+        std::chrono::steady_clock::time_point last_step;
+    };
+
+    /// The running keyboard-driven floating motion, if any.
+    std::optional<FloatingMotion> floating_motion;
+
+    /// Step the floating motion right before the frame is rendered.
+    wf::effect_hook_t on_floating_motion_frame = [&]() {
+        step_floating_motion();
+    };
+
+    /// Stop the floating motion once its keys are released.
+    wf::signal::connection_t<wf::input_event_signal<wlr_keyboard_key_event>>
+        on_floating_motion_key =
+            [&](wf::input_event_signal<wlr_keyboard_key_event> *data) {
+                if (data->event->state == WL_KEYBOARD_KEY_STATE_RELEASED)
+                    release_floating_motion_key(data->event->keycode);
+            };
+
+    /// Start moving the active floating node in dir while the key that
+    /// triggered the activator is held, or add the key to the running motion.
+    ///
+    /// \return false if the active node is tiled or no key triggered it.
+    bool start_floating_motion(Direction dir,
+                               const wf::activator_data_t &data);
+
+    /// Advance the floating motion to the current time.
+    void step_floating_motion();
+
+    /// Handle a key of the floating motion being released.
+    void release_floating_motion_key(std::uint32_t key);
+
+    /// Stop the floating motion and configure the node at its final position.
+    void stop_floating_motion();
+
+    /// Find a node of this output by id.
+    Node find_node(uint id);
+
+    /// Focus the next node in the focus history of the output, going back to
+    /// less recently used nodes or forward to more recently used ones.
+    bool focus_history(bool back);
 
 #define DECL_ACTIVATOR(NAME)                                                   \
     wf::option_wrapper_t<wf::activatorbinding_t> key_##NAME{                   \
@@ -1056,12 +1943,20 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
 
     DECL_ACTIVATOR(toggle_focus_tile);
 
+    DECL_ACTIVATOR(focus_back);
+    DECL_ACTIVATOR(focus_forward);
+
     DECL_ACTIVATOR(move_left);
     DECL_ACTIVATOR(move_right);
     DECL_ACTIVATOR(move_down);
     DECL_ACTIVATOR(move_up);
 
     DECL_ACTIVATOR(toggle_tile);
+
+    DECL_ACTIVATOR(undo);
+    DECL_ACTIVATOR(redo);
+
+    DECL_ACTIVATOR(dump_recorder);
 #undef DECL_ACTIVATOR
 
     wf::option_wrapper_t<wf::buttonbinding_t> button_move_activate{
@@ -1070,6 +1965,10 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
     wf::option_wrapper_t<wf::buttonbinding_t> button_resize_activate{
         "swayfire/button_resize_activate"};
 
+    /// Whether drags only draw an outline preview until the button is
+    /// released.
+    wf::option_wrapper_t<bool> drag_preview{"swayfire/drag_preview"};
+
     wf::button_callback on_move_activate;
     wf::button_callback on_resize_activate;
 
@@ -1144,14 +2043,24 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
         if (view->role != wf::VIEW_ROLE_TOPLEVEL || view->parent)
             return;
 
-        auto ws = workspaces.get(nonwf::get_view_workspace(view));
-
-        LOGD("attaching node in ", ws, ", ", view->to_string(), " : ",
-             view->get_title());
+        attach_view(view);
 
-        ws->insert_tiled_node(init_view_node(view));
+        // The view may come from a removed output.
+        idle_graft.run_once([&]() { graft_detached_layouts(); });
     };
 
+    /// Handle views leaving the output.
+    wf::signal::connection_t<wf::view_pre_moved_to_output_signal>
+        on_view_pre_moved_to_output =
+            [&](wf::view_pre_moved_to_output_signal *data) {
+                if (data->old_output != output)
+                    return;
+
+                // The node is destroyed, the new output attaches a new one.
+                if (auto vnode = get_view_node(data->view))
+                    (void)vnode->get_ws()->remove_node(vnode);
+            };
+
     /// Handle (un)minimized views.
     wf::signal::connection_t<wf::view_minimize_request_signal> on_view_minimized = [&](wf::view_minimize_request_signal *data) {
         auto minimizing = data->state;
@@ -1189,9 +2098,42 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
             }
         };
 
+    /// Handle requests to change the active workspace.
+    wf::signal::connection_t<wf::workspace_change_request_signal>
+        on_workspace_change_request =
+            [&](wf::workspace_change_request_signal *data) {
+                // The target ws may be shown by a switch animation before it
+                // becomes the current ws.
+                workspaces.get(data->new_viewport)->flush_pending_layout();
+            };
+
+    /// Handle views becoming (un)sticky.
+    wf::signal::connection_t<wf::view_set_sticky_signal> on_view_set_sticky =
+        [&](wf::view_set_sticky_signal *data) {
+            if (const auto node = get_view_node(data->view)) {
+                // Only floating roots live in the sticky layer.
+                if (!node->get_floating())
+                    return;
+
+                const bool is_sticky = sticky.contains(node);
+                if (StickyLayer::wants_sticky(node) && !is_sticky)
+                    sticky.insert_child(
+                        node->get_ws()->remove_floating_node(node, false));
+                else if (!StickyLayer::wants_sticky(node) && is_sticky)
+                    node->get_ws()->insert_floating_node(
+                        sticky.remove_child(node));
+            }
+        };
+
     /// Handle active workspace changing.
     wf::signal::connection_t<wf::workspace_changed_signal> on_workspace_changed =
         [&](wf::workspace_changed_signal *data) {
+            workspaces.get(data->new_viewport)->flush_pending_layout();
+            sticky.set_ws(workspaces.get(data->new_viewport));
+
+            previous_wsid = data->old_viewport;
+            schedule_layout_prefetch();
+
             const auto views = output->workspace->get_views_on_workspace(
                 data->new_viewport, wf::LAYER_WORKSPACE);
 
@@ -1208,6 +2150,9 @@ class Swayfire final : public wf::per_output_plugin_instance_t {
     WorkspaceRef get_view_workspace(wayfire_view view,
                                     bool with_transform = false);
 
+    /// Run prefetch_layouts() the next time the compositor is idle.
+    void schedule_layout_prefetch();
+
     // == Impl wf::plugin_interface_t ==
 
     void init() override;
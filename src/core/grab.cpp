@@ -2,6 +2,7 @@
 #include "core.hpp"
 
 #include <wayfire/nonstd/wlroots-full.hpp>
+#include <wayfire/opengl.hpp>
 
 // IActiveGrab
 
@@ -21,24 +22,150 @@ std::unique_ptr<IActiveGrab> IActiveGrab::try_activate(
 }
 
 IActiveGrab::~IActiveGrab() {
+    recorder::record(recorder::RecordType::GRAB_END, 0);
     plugin->output->deactivate_plugin(plugin->grab_interface);
 }
 
 // IActiveButtonDrag
 
+IActiveButtonDrag::IActiveButtonDrag(nonstd::observer_ptr<Swayfire> plugin,
+                                     wf::buttonbinding_t deactivate_butt)
+    : IActiveGrab(plugin),
+      deactivate_button(wf::buttonbinding_t(deactivate_butt).get_button()) {
+    plugin->output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+}
+
+IActiveButtonDrag::~IActiveButtonDrag() {
+    plugin->output->render->rem_effect(&on_frame);
+}
+
+void IActiveButtonDrag::flush_motion() {
+    if (!pending_motion)
+        return;
+
+    const auto p = *pending_motion;
+    pending_motion = std::nullopt;
+    frame_motion(p);
+}
+
+void IActiveButtonDrag::pointer_motion(std::uint32_t x, std::uint32_t y) {
+    // Only keep the latest position. It gets applied on the next frame.
+    pending_motion = {(int)x, (int)y};
+    plugin->output->render->schedule_redraw();
+}
+
 void IActiveButtonDrag::button(std::uint32_t b, std::uint32_t state) {
     if (b == deactivate_button && state == WLR_BUTTON_RELEASED) {
+        // Don't drop the last motion event of the gesture.
+        flush_motion();
+        release();
         plugin->active_grab = nullptr;
     }
 }
 
+// DragPreview
+
+constexpr int PREVIEW_BORDER_WIDTH = 2;
+static const wf::color_t PREVIEW_FILL_COLOR{0.16, 0.33, 0.47, 0.3};
+static const wf::color_t PREVIEW_BORDER_COLOR{0.18, 0.62, 0.96, 1.0};
+
+/// Render translucent rectangles with a solid border on top of the output.
+static void render_preview_rects(OutputRef output,
+                                 const std::vector<wf::geometry_t> &rects) {
+    const auto fb = output->render->get_target_framebuffer();
+    const auto matrix = fb.get_orthographic_projection();
+    const int bw = PREVIEW_BORDER_WIDTH;
+
+    OpenGL::render_begin(fb);
+    for (const auto &geo : rects) {
+        OpenGL::render_rectangle(geo, PREVIEW_FILL_COLOR, matrix);
+
+        OpenGL::render_rectangle({geo.x, geo.y, geo.width, bw},
+                                 PREVIEW_BORDER_COLOR, matrix);
+        OpenGL::render_rectangle(
+            {geo.x, geo.y + geo.height - bw, geo.width, bw},
+            PREVIEW_BORDER_COLOR, matrix);
+        OpenGL::render_rectangle({geo.x, geo.y, bw, geo.height},
+                                 PREVIEW_BORDER_COLOR, matrix);
+        OpenGL::render_rectangle({geo.x + geo.width - bw, geo.y, bw, geo.height},
+                                 PREVIEW_BORDER_COLOR, matrix);
+    }
+    OpenGL::render_end();
+}
+
+DragPreview::DragPreview(nonstd::observer_ptr<Swayfire> plugin, Node root)
+    : plugin(plugin), root(root) {
+    root->for_each_node([&](Node n) {
+        n->ref_pure_set_geo();
+        pure_nodes.push_back(n->get_id());
+    });
+
+    plugin->output->render->add_effect(&on_overlay, wf::OUTPUT_EFFECT_OVERLAY);
+    update();
+}
+
+DragPreview::~DragPreview() {
+    plugin->output->render->rem_effect(&on_overlay);
+    damage();
+
+    // Only unref the nodes we put in pure mode ourselves: nodes might have
+    // been added to or removed from the subtree during the drag.
+    root->for_each_node([&](Node n) {
+        if (std::find(pure_nodes.begin(), pure_nodes.end(), n->get_id()) !=
+            pure_nodes.end())
+            n->unref_pure_set_geo();
+    });
+    root->refresh_geometry();
+}
+
+void DragPreview::damage() {
+    for (const auto &geo : outlines)
+        plugin->output->render->damage(geo);
+}
+
+void DragPreview::update() {
+    damage();
+    outlines.clear();
+
+    const auto ws = root->get_ws();
+    const auto curr_wsid = plugin->output->workspace->get_current_workspace();
+
+    // The splits are pure too: lay them out top-down to get the geometries
+    // of the views.
+    root->for_each_node([&](Node n) {
+        auto geo = n->get_geometry();
+
+        if (auto split = n->as_split_node()) {
+            split->layout_children();
+
+            // Outline the title bar of the split, above its children.
+            const auto inner = split->get_inner_geometry();
+            if (inner.y <= geo.y)
+                return;
+            geo.height = inner.y - geo.y;
+        }
+
+        if (ws->wsid != curr_wsid)
+            geo = nonwf::local_to_relative_geometry(geo, ws->wsid, curr_wsid,
+                                                    plugin->output);
+        outlines.push_back(geo);
+    });
+
+    damage();
+}
+
+void DragPreview::render() { render_preview_rects(plugin->output, outlines); }
+
 // ActiveMove
 
-void ActiveMove::pointer_motion(std::uint32_t x, std::uint32_t y) {
+void ActiveMove::frame_motion(wf::point_t p) {
     auto geo = original_geo;
-    geo.x += (int)x - pointer_start.x;
-    geo.y += (int)y - pointer_start.y;
+    geo.x += p.x - pointer_start.x;
+    geo.y += p.y - pointer_start.y;
     dragged->set_geometry(geo);
+
+    if (preview)
+        preview->update();
 }
 
 std::unique_ptr<IActiveGrab>
@@ -53,6 +180,276 @@ ActiveMove::construct(nonstd::observer_ptr<Swayfire> plugin, Node dragged) {
         ret->original_geo = dragged->get_geometry();
         ret->pointer_start = {(int)p.x, (int)p.y};
 
+        recorder::record(recorder::RecordType::MOVE_BEGIN, dragged->get_id(),
+                         0, ret->original_geo);
+
+        if (plugin->drag_preview)
+            ret->preview = std::make_unique<DragPreview>(plugin, dragged);
+
+        return ret;
+    });
+}
+
+// LeafGrid
+
+LeafGrid::LeafGrid(WorkspaceRef ws, Node exclude) {
+    area = ws->get_workarea();
+    cols = std::max(1, (area.width + CELL_SIZE - 1) / CELL_SIZE);
+    rows = std::max(1, (area.height + CELL_SIZE - 1) / CELL_SIZE);
+    cells.resize(cols * rows);
+
+    // Only the active child of a stack is visible, so only it is indexed.
+    std::function<void(Node)> index = [&](Node n) {
+        if (auto split = n->as_split_node()) {
+            if (split->empty())
+                return;
+
+            if (split->is_stack()) {
+                index(split->get_active_child());
+            } else {
+                for (std::size_t i = 0; i < split->get_children_count(); i++)
+                    index(split->child_at(i));
+            }
+        } else if (n.get() != exclude.get()) {
+            insert({n->get_id(), n->get_geometry()});
+        }
+    };
+    index(ws->tiled_root.node.get());
+}
+
+void LeafGrid::insert(Leaf leaf) {
+    const auto idx = (std::uint32_t)leaves.size();
+    leaves.push_back(leaf);
+
+    const int x0 = std::clamp((leaf.geo.x - area.x) / CELL_SIZE, 0, cols - 1);
+    const int y0 = std::clamp((leaf.geo.y - area.y) / CELL_SIZE, 0, rows - 1);
+    const int x1 = std::clamp(
+        (leaf.geo.x + leaf.geo.width - 1 - area.x) / CELL_SIZE, 0, cols - 1);
+    const int y1 = std::clamp(
+        (leaf.geo.y + leaf.geo.height - 1 - area.y) / CELL_SIZE, 0, rows - 1);
+
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            cells[y * cols + x].push_back(idx);
+}
+
+std::optional<LeafGrid::Leaf> LeafGrid::at(wf::point_t p) const {
+    if (!(area & p))
+        return std::nullopt;
+
+    const int x = (p.x - area.x) / CELL_SIZE;
+    const int y = (p.y - area.y) / CELL_SIZE;
+
+    for (auto i : cells[y * cols + x])
+        if (leaves[i].geo & p)
+            return leaves[i];
+
+    return std::nullopt;
+}
+
+// ActiveTiledMove
+
+/// The portion of a leaf's width/height around its center that is the center
+/// drop zone.
+constexpr double DROP_CENTER_SIZE = 1.0 / 3.0;
+
+/// Compute the drop zone of a leaf under the given point.
+static DropZone calc_drop_zone(wf::geometry_t geo, wf::point_t p) {
+    // Offset of the point from the center, normalized to [-1, 1].
+    const double dx =
+        (double)(2 * (p.x - geo.x) - geo.width) / (double)geo.width;
+    const double dy =
+        (double)(2 * (p.y - geo.y) - geo.height) / (double)geo.height;
+
+    if (std::abs(dx) < DROP_CENTER_SIZE && std::abs(dy) < DROP_CENTER_SIZE)
+        return DropZone::CENTER;
+
+    if (std::abs(dx) > std::abs(dy))
+        return dx < 0 ? DropZone::LEFT : DropZone::RIGHT;
+    return dy < 0 ? DropZone::TOP : DropZone::BOTTOM;
+}
+
+/// Insert node just before/after a tiled target view node, in a parent split
+/// of the given type. The target is upgraded to a split of that type if its
+/// parent has a different type.
+static void insert_beside(ViewNodeRef target, OwnedNode node, SplitType type,
+                          bool after) {
+    auto split = target->parent->as_split_node();
+    if (!split || split->get_split_type() != type) {
+        target->set_prefered_split_type(type);
+        split = target->try_upgrade();
+    }
+
+    if (!split) {
+        LOGE("Cannot insert ", node, " next to ", target);
+        return;
+    }
+
+    if (after)
+        split->insert_child_back_of(target, std::move(node));
+    else
+        split->insert_child_front_of(target, std::move(node));
+}
+
+/// Swap two tiled nodes which may have different parents.
+static void swap_tiled_nodes(ViewNodeRef a, ViewNodeRef b) {
+    if (a->parent.get() == b->parent.get()) {
+        a->parent->swap_children(a, b);
+        return;
+    }
+
+    auto a_parent = a->parent->as_split_node();
+    if (!a_parent) {
+        LOGE("Tiled node without a split parent: ", a);
+        return;
+    }
+
+    // Remember where a was, take it out, put it in place of b and finally put
+    // b in the slot a was in.
+    Node a_next = nullptr;
+    for (std::size_t i = 0; i + 1 < a_parent->get_children_count(); i++)
+        if (a_parent->child_at(i).get() == a.get())
+            a_next = a_parent->child_at(i + 1);
+
+    auto owned_a = a_parent->remove_child(a);
+    auto owned_b = b->parent->swap_child(b, std::move(owned_a));
+
+    if (a_next)
+        a_parent->insert_child_front_of(a_next, std::move(owned_b));
+    else
+        a_parent->insert_child_back(std::move(owned_b));
+}
+
+ActiveTiledMove::ActiveTiledMove(nonstd::observer_ptr<Swayfire> plugin,
+                                 wf::buttonbinding_t deactivate_butt)
+    : IActiveButtonDrag(plugin, deactivate_butt) {
+    plugin->output->render->add_effect(&on_overlay, wf::OUTPUT_EFFECT_OVERLAY);
+}
+
+ActiveTiledMove::~ActiveTiledMove() {
+    plugin->output->render->rem_effect(&on_overlay);
+    damage();
+}
+
+wf::geometry_t ActiveTiledMove::get_zone_geometry() const {
+    auto geo = target->geo;
+    switch (zone) {
+    case DropZone::LEFT:
+        geo.width /= 2;
+        break;
+    case DropZone::RIGHT:
+        geo.x += geo.width / 2;
+        geo.width -= geo.width / 2;
+        break;
+    case DropZone::TOP:
+        geo.height /= 2;
+        break;
+    case DropZone::BOTTOM:
+        geo.y += geo.height / 2;
+        geo.height -= geo.height / 2;
+        break;
+    case DropZone::CENTER:
+        break;
+    }
+    return geo;
+}
+
+void ActiveTiledMove::damage() {
+    if (target)
+        plugin->output->render->damage(get_zone_geometry());
+}
+
+void ActiveTiledMove::render() {
+    if (target)
+        render_preview_rects(plugin->output, {get_zone_geometry()});
+}
+
+void ActiveTiledMove::frame_motion(wf::point_t p) {
+    auto ntarget = leaves->at(p);
+    auto nzone = ntarget ? calc_drop_zone(ntarget->geo, p) : DropZone::CENTER;
+
+    const bool same_target =
+        ntarget.has_value() == target.has_value() &&
+        (!ntarget || ntarget->node_id == target->node_id);
+    if (same_target && nzone == zone)
+        return;
+
+    damage();
+    target = ntarget;
+    zone = nzone;
+    damage();
+}
+
+void ActiveTiledMove::release() { drop(); }
+
+void ActiveTiledMove::drop() {
+    if (!target)
+        return;
+
+    // Nodes may have been destroyed during the drag, so look them up again.
+    ViewNodeRef dragged = nullptr;
+    ViewNodeRef drop_on = nullptr;
+    ws->for_each_node([&](Node n) {
+        if (auto v = n->as_view_node()) {
+            if (v->get_id() == dragged_id)
+                dragged = v;
+            else if (v->get_id() == target->node_id)
+                drop_on = v;
+        }
+    });
+
+    if (!dragged || !drop_on || dragged->get_floating() ||
+        drop_on->get_floating())
+        return;
+
+    recorder::record(recorder::RecordType::DROP, dragged_id, target->node_id,
+                     get_zone_geometry(), (std::uint32_t)zone);
+    auto layout_before = ws->capture_layout();
+
+    ws->batch_layout([&]() {
+        if (zone == DropZone::CENTER) {
+            auto target_parent = drop_on->parent->as_split_node();
+            if (!target_parent || !target_parent->is_stack() ||
+                dragged->parent.get() == drop_on->parent.get()) {
+                swap_tiled_nodes(dragged, drop_on);
+                return;
+            }
+
+            // Join the tab group of the target.
+            const auto stack_type = target_parent->get_split_type();
+            auto owned = ws->remove_tiled_node(dragged, false);
+            insert_beside(drop_on, std::move(owned), stack_type, true);
+            return;
+        }
+
+        const bool horiz = zone == DropZone::LEFT || zone == DropZone::RIGHT;
+        const bool after = zone == DropZone::RIGHT || zone == DropZone::BOTTOM;
+
+        auto owned = ws->remove_tiled_node(dragged, false);
+        insert_beside(drop_on, std::move(owned),
+                      horiz ? SplitType::VSPLIT : SplitType::HSPLIT, after);
+    });
+
+    plugin->record_layout(std::move(layout_before));
+    dragged->set_active();
+}
+
+std::unique_ptr<IActiveGrab>
+ActiveTiledMove::construct(nonstd::observer_ptr<Swayfire> plugin,
+                           ViewNodeRef dragged) {
+    return try_activate(plugin, [&]() {
+        auto ret = std::make_unique<ActiveTiledMove>(
+            plugin, plugin->button_move_activate);
+
+        ret->dragged_id = dragged->get_id();
+        ret->ws = dragged->get_ws();
+        ret->leaves = std::make_unique<LeafGrid>(ret->ws, dragged);
+
+        recorder::record(recorder::RecordType::TILED_MOVE_BEGIN,
+                         ret->dragged_id, 0, dragged->get_geometry());
+
+        wf::get_core().set_cursor("grabbing");
+
         return ret;
     });
 }
@@ -97,9 +494,9 @@ std::uint32_t resize_calc_resizing_edges(wf::geometry_t geo, wf::point_t p) {
 }
 #undef RESIZE_MARGIN
 
-void ActiveResize::pointer_motion(std::uint32_t x, std::uint32_t y) {
-    const int dw = (int)x - pointer_start.x;
-    const int dh = (int)y - pointer_start.y;
+void ActiveResize::frame_motion(wf::point_t p) {
+    const int dw = p.x - pointer_start.x;
+    const int dh = p.y - pointer_start.y;
 
     if (dw == 0 && dh == 0)
         return;
@@ -124,6 +521,9 @@ void ActiveResize::pointer_motion(std::uint32_t x, std::uint32_t y) {
             v->unref_pure_set_geo();
     });
     root_node->refresh_geometry();
+
+    if (preview)
+        preview->update();
 }
 
 std::unique_ptr<IActiveGrab>
@@ -140,12 +540,20 @@ ActiveResize::construct(nonstd::observer_ptr<Swayfire> plugin, Node dragged) {
         ret->resizing_edges =
             resize_calc_resizing_edges(ret->original_geo, ret->pointer_start);
 
+        recorder::record(recorder::RecordType::RESIZE_BEGIN, dragged->get_id(),
+                         0, ret->original_geo, ret->resizing_edges);
+
         ret->root_node = ret->dragged->find_floating_parent();
         if (!ret->root_node)
             ret->root_node = ret->dragged->get_ws()->tiled_root.node.get();
 
+        ret->layout_before = ret->dragged->get_ws()->capture_layout();
         ret->root_node->begin_resize();
 
+        if (plugin->drag_preview)
+            ret->preview =
+                std::make_unique<DragPreview>(plugin, ret->root_node);
+
         wf::get_core().set_cursor(
             wlr_xcursor_get_resize_name((wlr_edges)(ret->resizing_edges)));
 
@@ -153,7 +561,13 @@ ActiveResize::construct(nonstd::observer_ptr<Swayfire> plugin, Node dragged) {
     });
 }
 
-ActiveResize::~ActiveResize() { root_node->end_resize(); }
+ActiveResize::~ActiveResize() {
+    // Commit the previewed layout before the preferred sizes get cleared.
+    preview = nullptr;
+    root_node->end_resize();
+
+    plugin->record_layout(std::move(layout_before));
+}
 
 // Swayfire
 
@@ -188,6 +602,11 @@ void Swayfire::init_grab_interface() {
                         active_grab = std::move(active);
                         return true;
                     }
+                } else if (!node->is_fullscreen()) {
+                    if (auto active = ActiveTiledMove::construct(this, node)) {
+                        active_grab = std::move(active);
+                        return true;
+                    }
                 }
             }
         }
@@ -3,6 +3,8 @@
 
 #include "core.hpp"
 
+#include <wayfire/render-manager.hpp>
+
 /// RAII gesture controller interface.
 class IActiveGrab {
   protected:
@@ -31,19 +33,81 @@ class IActiveGrab {
 };
 
 /// RAII button drag gesture controller interface.
+///
+/// Pointer motion is accumulated and only applied once per output frame, the
+/// latest pointer position winning over any older unapplied position.
 class IActiveButtonDrag : public IActiveGrab {
   private:
     /// The button that must be unpressed to deactivate the gesture.
     std::uint32_t deactivate_button;
 
+    /// The latest pointer position that has not been applied yet.
+    std::optional<wf::point_t> pending_motion;
+
+    /// Apply the pending pointer motion right before the frame is rendered.
+    wf::effect_hook_t on_frame = [&]() { flush_motion(); };
+
+  protected:
+    /// Apply the pending pointer motion if there is any.
+    void flush_motion();
+
+    /// Handle the latest pointer position accumulated over the last frame.
+    virtual void frame_motion(wf::point_t p) = 0;
+
+    /// Handle the gesture being completed by releasing its button, right
+    /// before the grab is destroyed. Not called when the grab is cancelled.
+    virtual void release() {}
+
   public:
+    void pointer_motion(std::uint32_t x, std::uint32_t y) final;
     void button(std::uint32_t, std::uint32_t) override;
 
     IActiveButtonDrag(nonstd::observer_ptr<Swayfire> plugin,
-                      wf::buttonbinding_t deactivate_butt)
-        : IActiveGrab(plugin),
-          deactivate_button(
-              wf::buttonbinding_t(deactivate_butt).get_button()){};
+                      wf::buttonbinding_t deactivate_butt);
+
+    ~IActiveButtonDrag() override;
+};
+
+/// Outline preview of the geometries of a subtree during a drag.
+///
+/// While the preview is alive, all the nodes of the subtree are kept in pure
+/// set_geometry() mode: the layout is computed in a dry-run and only the
+/// resulting geometries, split title bars included, are drawn as outlines.
+/// Views and split decorations stay in place until the preview is destroyed,
+/// which commits the final layout with a single configure per client.
+class DragPreview {
+  private:
+    /// Reference to swayfire.
+    nonstd::observer_ptr<Swayfire> plugin;
+
+    /// The root of the previewed subtree.
+    Node root;
+
+    /// Ids of the nodes put in pure set_geometry() mode by this preview.
+    std::vector<uint> pure_nodes;
+
+    /// The output-local geometries currently drawn.
+    std::vector<wf::geometry_t> outlines;
+
+    /// Draw the outlines on top of the output.
+    wf::effect_hook_t on_overlay = [&]() { render(); };
+
+    /// Damage the area covered by the current outlines.
+    void damage();
+
+    /// Render the outlines.
+    void render();
+
+  public:
+    DragPreview(nonstd::observer_ptr<Swayfire> plugin, Node root);
+    DragPreview(const DragPreview &) = delete;
+    DragPreview &operator=(const DragPreview &) = delete;
+
+    /// Commit the previewed layout and stop drawing outlines.
+    ~DragPreview();
+
+    /// Redraw the outlines from the current (dry-run) node geometries.
+    void update();
 };
 
 /// Button drag view move gesture.
@@ -52,6 +116,9 @@ class ActiveMove final : public IActiveButtonDrag {
     /// The node being dragged.
     Node dragged;
 
+    /// The outline preview, if enabled.
+    std::unique_ptr<DragPreview> preview;
+
     /// The original outer geometry of the dragged node.
     wf::geometry_t original_geo;
 
@@ -63,13 +130,114 @@ class ActiveMove final : public IActiveButtonDrag {
                wf::buttonbinding_t deactivate_butt)
         : IActiveButtonDrag(plugin, deactivate_butt) {}
 
-    void pointer_motion(std::uint32_t x, std::uint32_t y) override;
+    void frame_motion(wf::point_t p) override;
 
     /// Try to activate the grab_interface and begin an move gesture.
     static std::unique_ptr<IActiveGrab>
     construct(nonstd::observer_ptr<Swayfire> plugin, Node dragged);
 };
 
+/// Uniform grid spatial index of the visible tiled leaves of a workspace.
+///
+/// The leaf geometries are snapshotted when the index is built, so lookups
+/// never walk the tree.
+class LeafGrid {
+  public:
+    /// An indexed leaf.
+    struct Leaf {
+        uint node_id;       ///< The id of the leaf view node.
+        wf::geometry_t geo; ///< The outer geometry of the leaf.
+    };
+
+  private:
+    /// The side length of a grid cell in pixels.
+    static constexpr int CELL_SIZE = 128;
+
+    /// The area covered by the grid.
+    wf::geometry_t area;
+
+    /// The amount of columns and rows of the grid.
+    int cols = 0, rows = 0;
+
+    /// All the indexed leaves.
+    std::vector<Leaf> leaves;
+
+    /// Indices into leaves of the leaves overlapping each cell.
+    std::vector<std::vector<std::uint32_t>> cells;
+
+    /// Add a leaf to the index.
+    void insert(Leaf leaf);
+
+  public:
+    /// Index the visible tiled leaves of ws, omitting the exclude node.
+    LeafGrid(WorkspaceRef ws, Node exclude);
+
+    /// Find the leaf under the given point.
+    [[nodiscard]] std::optional<Leaf> at(wf::point_t p) const;
+};
+
+/// The part of a leaf the dragged node is dropped on.
+enum struct DropZone : std::uint8_t {
+    LEFT,
+    RIGHT,
+    TOP,
+    BOTTOM,
+    CENTER,
+};
+
+/// Button drag tiled node move gesture.
+///
+/// The dragged node stays in place while the drop zone under the pointer is
+/// highlighted. The tree is only mutated once, when the button is released.
+class ActiveTiledMove final : public IActiveButtonDrag {
+  private:
+    /// The id of the node being dragged.
+    uint dragged_id;
+
+    /// The workspace of the dragged node.
+    WorkspaceRef ws;
+
+    /// The index of the leaves the node can be dropped on.
+    std::unique_ptr<LeafGrid> leaves;
+
+    /// The leaf currently hovered.
+    std::optional<LeafGrid::Leaf> target;
+
+    /// The drop zone currently hovered on the target.
+    DropZone zone = DropZone::CENTER;
+
+    /// Draw the hovered drop zone on top of the output.
+    wf::effect_hook_t on_overlay = [&]() { render(); };
+
+    /// Get the output-local area highlighted for the current drop zone.
+    [[nodiscard]] wf::geometry_t get_zone_geometry() const;
+
+    /// Damage the highlighted drop zone.
+    void damage();
+
+    /// Render the highlighted drop zone.
+    void render();
+
+    /// Apply the drop on the tree.
+    void drop();
+
+  public:
+    ActiveTiledMove(nonstd::observer_ptr<Swayfire> plugin,
+                    wf::buttonbinding_t deactivate_butt);
+
+    /// Stop highlighting the drop zone.
+    ~ActiveTiledMove() override;
+
+    void frame_motion(wf::point_t p) override;
+
+    /// Drop the dragged node on the hovered drop zone.
+    void release() override;
+
+    /// Try to activate the grab_interface and begin a tiled move gesture.
+    static std::unique_ptr<IActiveGrab>
+    construct(nonstd::observer_ptr<Swayfire> plugin, ViewNodeRef dragged);
+};
+
 /// Button drag view resize gesture.
 class ActiveResize final : public IActiveButtonDrag {
   private:
@@ -89,6 +257,12 @@ class ActiveResize final : public IActiveButtonDrag {
     /// The moving edges of the resizing node.
     std::uint8_t resizing_edges;
 
+    /// The outline preview, if enabled.
+    std::unique_ptr<DragPreview> preview;
+
+    /// The layout from before the resize, recorded in the history when done.
+    LayoutSnapshot layout_before;
+
   public:
     ActiveResize(nonstd::observer_ptr<Swayfire> plugin,
                  wf::buttonbinding_t deactivate_butt)
@@ -96,7 +270,7 @@ class ActiveResize final : public IActiveButtonDrag {
 
     ~ActiveResize() override;
 
-    void pointer_motion(std::uint32_t x, std::uint32_t y) override;
+    void frame_motion(wf::point_t p) override;
 
     /// Try to activate the grab_interface and begin an resize gesture.
     static std::unique_ptr<IActiveGrab>
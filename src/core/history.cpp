@@ -0,0 +1,383 @@
+#include "core.hpp"
+
+#include <unordered_map>
+
+// LayoutHistory
+
+void LayoutHistory::push(std::deque<LayoutSnapshot> &stack,
+                         LayoutSnapshot snap, std::size_t capacity) {
+    stack.push_back(std::move(snap));
+    while (stack.size() > capacity)
+        stack.pop_front();
+}
+
+void LayoutHistory::record(LayoutSnapshot snap, std::size_t capacity) {
+    push(undo_stack, std::move(snap), capacity);
+    redo_stack.clear();
+}
+
+void LayoutHistory::push_undo(LayoutSnapshot snap, std::size_t capacity) {
+    push(undo_stack, std::move(snap), capacity);
+}
+
+void LayoutHistory::push_redo(LayoutSnapshot snap, std::size_t capacity) {
+    push(redo_stack, std::move(snap), capacity);
+}
+
+std::optional<LayoutSnapshot> LayoutHistory::pop_undo() {
+    if (undo_stack.empty())
+        return std::nullopt;
+
+    auto snap = std::move(undo_stack.back());
+    undo_stack.pop_back();
+    return snap;
+}
+
+std::optional<LayoutSnapshot> LayoutHistory::pop_redo() {
+    if (redo_stack.empty())
+        return std::nullopt;
+
+    auto snap = std::move(redo_stack.back());
+    redo_stack.pop_back();
+    return snap;
+}
+
+// Workspace
+
+/// Append the records of the subtree of node to records.
+static void capture_node(Node node, std::vector<LayoutRecord> &records,
+                         double ratio, bool active_child) {
+    LayoutRecord record;
+    record.ratio = ratio;
+
+    if (active_child)
+        record.flags |= LayoutRecord::ACTIVE_CHILD;
+
+    if (node->get_floating())
+        record.flags |= LayoutRecord::FLOATING;
+    record.floating_geo = node->get_geometry();
+
+    if (auto split = node->as_split_node()) {
+        record.flags |= LayoutRecord::SPLIT;
+        if (split->was_vsplit)
+            record.flags |= LayoutRecord::WAS_VSPLIT;
+        record.split_type = split->get_split_type();
+        record.child_count = split->get_children_count();
+        records.push_back(record);
+
+        const auto ratios = split->get_ratios();
+        const auto active =
+            split->empty() ? nullptr : split->get_active_child();
+        for (std::size_t i = 0; i < split->get_children_count(); i++) {
+            const auto child = split->child_at(i);
+            capture_node(child, records, ratios[i],
+                         child.get() == active.get());
+        }
+    } else if (auto vnode = node->as_view_node()) {
+        record.view_id = vnode->view->get_id();
+        records.push_back(record);
+    }
+}
+
+LayoutSnapshot Workspace::capture_layout() {
+    LayoutSnapshot snap;
+    snap.wsid = wsid;
+
+    if (active_node)
+        if (auto vnode = active_node->as_view_node())
+            snap.active_view_id = vnode->view->get_id();
+
+    capture_node(tiled_root.node.get(), snap.records, 1.0, false);
+    for (auto &floating : floating_nodes)
+        capture_node(floating.node.get(), snap.records, 1.0, false);
+
+    return snap;
+}
+
+/// Take the subtree of node apart, moving its view nodes into the pool.
+///
+/// Splits are emptied while still attached to their parent so that their
+/// removal never notifies a missing parent.
+static void dismantle_children(SplitNodeRef split, ViewNodePool &pool) {
+    while (!split->empty()) {
+        const auto child = split->child_at(0);
+        if (auto child_split = child->as_split_node())
+            dismantle_children(child_split, pool);
+
+        auto owned = split->remove_child(child);
+        if (auto vnode = owned->as_view_node())
+            pool.emplace(vnode->view->get_id(), std::move(owned));
+    }
+}
+
+/// Skip the records of the subtree starting at records[i].
+static void skip_records(const std::vector<LayoutRecord> &records,
+                         std::size_t &i) {
+    const auto count = records.at(i++).child_count;
+    for (std::uint32_t c = 0; c < count && i < records.size(); c++)
+        skip_records(records, i);
+}
+
+/// Rebuild the children of split from the records following its own record.
+static void restore_children(SplitNodeRef split, const LayoutRecord &record,
+                             const std::vector<LayoutRecord> &records,
+                             std::size_t &i, ViewNodePool &pool) {
+    std::vector<double> ratios;
+    Node active = nullptr;
+
+    for (std::uint32_t c = 0; c < record.child_count && i < records.size();
+         c++) {
+        const auto &child_record = records.at(i);
+        Node child = nullptr;
+
+        if (child_record.flags & LayoutRecord::SPLIT) {
+            i++;
+            auto owned = std::make_unique<SplitNode>(split->get_geometry(),
+                                                     child_record.split_type);
+            owned->was_vsplit = child_record.flags & LayoutRecord::WAS_VSPLIT;
+            auto child_split = owned.get();
+            split->insert_child_back(std::move(owned));
+            restore_children(child_split, child_record, records, i, pool);
+
+            if (child_split->empty()) {
+                (void)split->remove_child(child_split);
+                continue;
+            }
+            child = child_split;
+        } else {
+            skip_records(records, i);
+
+            auto it = pool.find(child_record.view_id);
+            if (it == pool.end())
+                continue;
+
+            child = it->second.get();
+            split->insert_child_back(std::move(it->second));
+            pool.erase(it);
+        }
+
+        ratios.push_back(child_record.ratio);
+        if (child_record.flags & LayoutRecord::ACTIVE_CHILD)
+            active = child;
+    }
+
+    split->set_ratios(ratios);
+    if (active)
+        split->set_active_child(active);
+}
+
+void Workspace::restore_floating(
+    const LayoutSnapshot &snap, std::size_t i, ViewNodePool &pool,
+    const std::function<wf::geometry_t(wf::geometry_t)> &map_geo) {
+    while (i < snap.records.size()) {
+        const auto &record = snap.records.at(i);
+        const auto geo = map_geo(record.floating_geo);
+
+        if (record.flags & LayoutRecord::SPLIT) {
+            i++;
+            auto owned = std::make_unique<SplitNode>(geo, record.split_type);
+            owned->was_vsplit = record.flags & LayoutRecord::WAS_VSPLIT;
+            auto split = owned.get();
+            insert_floating_node(std::move(owned));
+            restore_children(split, record, snap.records, i, pool);
+
+            if (split->empty())
+                (void)remove_floating_node(split, false);
+            else
+                split->set_geometry(geo);
+        } else {
+            skip_records(snap.records, i);
+
+            auto it = pool.find(record.view_id);
+            if (it == pool.end())
+                continue;
+
+            auto node = it->second.get();
+            insert_floating_node(std::move(it->second));
+            pool.erase(it);
+            node->set_geometry(geo);
+        }
+    }
+}
+
+void Workspace::restore_layout(const LayoutSnapshot &snap) {
+    if (snap.records.empty() ||
+        !(snap.records.front().flags & LayoutRecord::SPLIT))
+        return;
+
+    ViewNodePool pool;
+    std::unordered_map<std::uint32_t, ViewNodeRef> views;
+
+    batch_layout([&]() {
+        const auto &root_record = snap.records.front();
+
+        // Detach the current trees and take them apart.
+        auto old_root = swap_tiled_root(
+            std::make_unique<SplitNode>(workarea, root_record.split_type));
+        tiled_root.node->was_vsplit =
+            root_record.flags & LayoutRecord::WAS_VSPLIT;
+        active_node = tiled_root.node;
+
+        std::vector<OwnedNode> old_floating;
+        while (!floating_nodes.empty())
+            old_floating.push_back(
+                remove_floating_node(floating_nodes.back().node.get(), false));
+
+        dismantle_children(old_root.get(), pool);
+        for (auto &node : old_floating) {
+            if (auto split = node->as_split_node())
+                dismantle_children(split, pool);
+            else if (auto vnode = node->as_view_node())
+                pool.emplace(vnode->view->get_id(), std::move(node));
+        }
+
+        for (auto &[id, node] : pool)
+            views[id] = node->as_view_node();
+
+        // Rebuild the tiled tree then the floating trees.
+        std::size_t i = 1;
+        restore_children(tiled_root.node.get(), root_record, snap.records, i,
+                         pool);
+
+        restore_floating(snap, i, pool,
+                         [](wf::geometry_t geo) { return geo; });
+
+        // Views that appeared after the snapshot was taken.
+        for (auto &[id, node] : pool)
+            insert_child(std::move(node));
+        pool.clear();
+    });
+
+    auto active_it = views.find(snap.active_view_id);
+    const Node active = active_it != views.end() && active_it->second->parent
+                            ? Node(active_it->second)
+                            : tiled_root.node->get_last_active_node();
+
+    // Don't steal the focus for a workspace that isn't shown.
+    if (is_visible()) {
+        set_active_node(active);
+    } else {
+        active_node = active;
+        active->parent->set_active_child(active);
+    }
+}
+
+void Workspace::graft_layout(const LayoutSnapshot &snap, ViewNodePool &pool,
+                             double sx, double sy) {
+    if (snap.records.empty() ||
+        !(snap.records.front().flags & LayoutRecord::SPLIT))
+        return;
+
+    const auto scale = [&](wf::geometry_t geo) {
+        return wf::geometry_t{
+            (int)(geo.x * sx),
+            (int)(geo.y * sy),
+            std::max(MIN_VIEW_SIZE, (int)(geo.width * sx)),
+            std::max(MIN_VIEW_SIZE, (int)(geo.height * sy)),
+        };
+    };
+
+    batch_layout([&]() {
+        const auto &root_record = snap.records.front();
+
+        // The old tiled root becomes a child of the tiled root.
+        auto owned_graft = std::make_unique<SplitNode>(
+            tiled_root.node->get_geometry(), root_record.split_type);
+        owned_graft->was_vsplit = root_record.flags & LayoutRecord::WAS_VSPLIT;
+        auto graft = owned_graft.get();
+        insert_child(std::move(owned_graft));
+
+        std::size_t i = 1;
+        restore_children(graft, root_record, snap.records, i, pool);
+        if (graft->empty())
+            (void)remove_tiled_node(graft, false);
+
+        restore_floating(snap, i, pool, scale);
+    });
+}
+
+// Swayfire
+
+void Swayfire::record_layout(LayoutSnapshot before) {
+    if (!workspaces.contains(before.wsid))
+        return;
+
+    auto ws = workspaces.get(before.wsid);
+    if (ws->capture_layout().same_layout(before))
+        return;
+
+    ws->history.record(std::move(before), std::max(0, (int)history_size));
+}
+
+bool Swayfire::record_layout_change(WorkspaceRef ws,
+                                    const std::function<bool()> &mutation) {
+    auto snap = ws->capture_layout();
+    if (!mutation())
+        return false;
+
+    record_layout(std::move(snap));
+    return true;
+}
+
+/// The name of the layout handoff data on the output.
+static const char *const LAYOUT_HANDOFF_DATA = "swayfire-layout-handoff";
+
+std::vector<LayoutSnapshot> Swayfire::capture_layouts() {
+    std::vector<LayoutSnapshot> layouts;
+    const auto curr_wsid = output->workspace->get_current_workspace();
+
+    workspaces.for_each([&](WorkspaceRef ws) {
+        auto snap = ws->capture_layout();
+
+        // Sticky nodes are restored as floating nodes, which puts them back
+        // in the sticky layer.
+        if (ws->wsid == curr_wsid)
+            for (const auto &node : sticky.get_nodes())
+                capture_node(node.get(), snap.records, 1.0, false);
+
+        layouts.push_back(std::move(snap));
+    });
+
+    return layouts;
+}
+
+void Swayfire::save_layout_handoff() {
+    auto handoff = std::make_unique<LayoutHandoff>();
+    handoff->layouts = capture_layouts();
+    output->store_data(std::move(handoff), LAYOUT_HANDOFF_DATA);
+}
+
+std::vector<LayoutSnapshot> Swayfire::take_layout_handoff() {
+    std::vector<LayoutSnapshot> layouts;
+
+    if (auto handoff = output->get_data<LayoutHandoff>(LAYOUT_HANDOFF_DATA)) {
+        layouts = std::move(handoff->layouts);
+        output->erase_data(LAYOUT_HANDOFF_DATA);
+    }
+
+    return layouts;
+}
+
+bool Swayfire::on_undo(const wf::activator_data_t &) {
+    auto ws = get_current_workspace();
+    auto snap = ws->history.pop_undo();
+    if (!snap)
+        return false;
+
+    ws->history.push_redo(ws->capture_layout(),
+                          std::max(0, (int)history_size));
+    ws->restore_layout(*snap);
+    return true;
+}
+
+bool Swayfire::on_redo(const wf::activator_data_t &) {
+    auto ws = get_current_workspace();
+    auto snap = ws->history.pop_redo();
+    if (!snap)
+        return false;
+
+    ws->history.push_undo(ws->capture_layout(),
+                          std::max(0, (int)history_size));
+    ws->restore_layout(*snap);
+    return true;
+}
@@ -0,0 +1,149 @@
+#include "core.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <wayfire/output-layout.hpp>
+
+/// The layouts of an output, kept by name in case the output is removed.
+struct DetachedLayouts {
+    /// The layouts of the workspaces of the output.
+    std::vector<LayoutSnapshot> layouts;
+
+    /// The workarea of the output, to scale floating geometries with.
+    wf::dimensions_t workarea;
+
+    /// Whether the layouts were grafted onto another output.
+    bool grafted = false;
+};
+
+/// The layouts of the outputs swayfire was finalized on, by output name.
+///
+/// Shared by the instances of all outputs. An entry is dropped when an
+/// instance is initialized on an output of the same name again.
+static std::unordered_map<std::string, DetachedLayouts> detached_outputs;
+
+// Swayfire
+
+void Swayfire::save_detached_layouts() {
+    DetachedLayouts detached;
+    detached.workarea = wf::dimensions(output->workspace->get_workarea());
+    detached.layouts = capture_layouts();
+    detached_outputs[output->to_string()] = std::move(detached);
+}
+
+std::vector<LayoutSnapshot> Swayfire::reclaim_detached_layouts() {
+    auto it = detached_outputs.find(output->to_string());
+    if (it == detached_outputs.end())
+        return {};
+
+    auto detached = std::move(it->second);
+    detached_outputs.erase(it);
+
+    if (!detached.grafted)
+        return std::move(detached.layouts);
+
+    // Move the views back from the outputs they were grafted onto. They are
+    // attached by init() along with the views already here.
+    std::unordered_set<std::uint32_t> ids;
+    for (const auto &snap : detached.layouts)
+        for (const auto &record : snap.records)
+            if (!(record.flags & LayoutRecord::SPLIT))
+                ids.insert(record.view_id);
+
+    for (auto view : wf::get_core().get_all_views())
+        if (view->get_output() != output && ids.count(view->get_id()) &&
+            get_view_node(view))
+            wf::get_core().move_view_to_output(view, output, false);
+
+    return std::move(detached.layouts);
+}
+
+/// Whether the layouts of a removed output are waiting to be grafted.
+static bool is_graft_pending(const std::string &name,
+                             const DetachedLayouts &detached) {
+    return !detached.grafted &&
+           !wf::get_core().output_layout->find_output(name);
+}
+
+void Swayfire::graft_detached_layouts() {
+    // Grafted entries are kept to move the views back, and this runs on every
+    // view attach: bail out before collecting the nodes.
+    if (std::none_of(detached_outputs.begin(), detached_outputs.end(),
+                     [](const auto &entry) {
+                         return is_graft_pending(entry.first, entry.second);
+                     }))
+        return;
+
+    const auto workarea = wf::dimensions(output->workspace->get_workarea());
+    const auto grid = output->workspace->get_workspace_grid_size();
+
+    // The nodes of the views on this output, by view id.
+    std::unordered_map<std::uint32_t, ViewNodeRef> nodes;
+    workspaces.for_each([&](WorkspaceRef ws) {
+        ws->for_each_node([&](Node node) {
+            if (auto vnode = node->as_view_node())
+                nodes[vnode->view->get_id()] = vnode;
+        });
+    });
+    for (const auto &node : sticky.get_nodes())
+        if (auto vnode = node->as_view_node())
+            nodes[vnode->view->get_id()] = vnode;
+
+    for (auto &[name, detached] : detached_outputs) {
+        // Only graft the layouts of outputs that are gone.
+        if (!is_graft_pending(name, detached))
+            continue;
+
+        const double sx = detached.workarea.width > 0
+                              ? (double)workarea.width / detached.workarea.width
+                              : 1.0;
+        const double sy =
+            detached.workarea.height > 0
+                ? (double)workarea.height / detached.workarea.height
+                : 1.0;
+
+        bool grafted = false;
+        for (const auto &snap : detached.layouts) {
+            // Take the nodes of the snapshot out of the trees they were
+            // attached to.
+            ViewNodePool pool;
+            for (const auto &record : snap.records) {
+                if (record.flags & LayoutRecord::SPLIT)
+                    continue;
+
+                auto it = nodes.find(record.view_id);
+                if (it == nodes.end())
+                    continue;
+
+                auto vnode = it->second;
+                nodes.erase(it);
+                auto owned = vnode->get_ws()->remove_node(vnode);
+                pool.emplace(record.view_id, std::move(owned));
+            }
+
+            if (pool.empty())
+                continue;
+
+            const wf::point_t wsid = {
+                std::clamp(snap.wsid.x, 0, grid.width - 1),
+                std::clamp(snap.wsid.y, 0, grid.height - 1),
+            };
+            auto ws = workspaces.get(wsid);
+            ws->graft_layout(snap, pool, sx, sy);
+
+            // Nodes whose place in the snapshot was lost with it.
+            for (auto &[id, node] : pool)
+                ws->insert_child(std::move(node));
+
+            // Don't leave the views where they were if ws is hidden and
+            // defers its layout.
+            ws->flush_pending_layout();
+
+            grafted = true;
+        }
+
+        detached.grafted = grafted;
+    }
+}
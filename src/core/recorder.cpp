@@ -0,0 +1,151 @@
+#include "recorder.hpp"
+
+#include <array>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace recorder {
+
+static_assert((RECORDER_CAPACITY & (RECORDER_CAPACITY - 1)) == 0,
+              "The recorder capacity must be a power of two.");
+
+/// Header of a dump file, followed by the records oldest first.
+struct DumpHeader {
+    char magic[8];              ///< "SWFREC1\0".
+    std::uint32_t record_size;  ///< sizeof(Record).
+    std::uint32_t record_count; ///< The amount of records following.
+    std::uint64_t recorded;     ///< The total amount of records ever made.
+};
+
+/// The ring of records.
+static std::array<Record, RECORDER_CAPACITY> ring;
+
+/// The total amount of records ever made. The next record goes at
+/// recorded % RECORDER_CAPACITY.
+static std::uint64_t recorded = 0;
+
+/// The default dump path, computed when the crash handlers are installed.
+static char dump_path[PATH_MAX] = "";
+
+/// The fatal signals the ring is dumped on.
+static constexpr std::array<int, 5> FATAL_SIGNALS = {
+    SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL,
+};
+
+/// The handlers that were installed before ours.
+static std::array<struct sigaction, FATAL_SIGNALS.size()> old_actions;
+
+/// The amount of times the crash handlers were installed.
+static int install_count = 0;
+
+void record(RecordType type, std::uint32_t node, std::uint32_t other,
+            wf::geometry_t geo, std::uint32_t arg) {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    auto &r = ring[recorded++ & (RECORDER_CAPACITY - 1)];
+    r.time_ns =
+        (std::uint64_t)ts.tv_sec * 1000000000 + (std::uint64_t)ts.tv_nsec;
+    r.node = node;
+    r.other = other;
+    r.geo = geo;
+    r.arg = arg;
+    r.type = type;
+}
+
+/// Write the whole buffer to fd.
+static bool write_all(int fd, const void *buf, std::size_t len) {
+    const auto *p = static_cast<const char *>(buf);
+    while (len > 0) {
+        const auto n = ::write(fd, p, len);
+        if (n < 0)
+            return false;
+
+        p += n;
+        len -= (std::size_t)n;
+    }
+    return true;
+}
+
+bool dump(const char *path) {
+    const int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+
+    // Snapshot the counter, a signal may interrupt us while recording.
+    const auto total = recorded;
+    const auto count = total < RECORDER_CAPACITY ? total : RECORDER_CAPACITY;
+    const auto head = total & (RECORDER_CAPACITY - 1);
+
+    const DumpHeader header = {
+        {'S', 'W', 'F', 'R', 'E', 'C', '1', '\0'},
+        (std::uint32_t)sizeof(Record),
+        (std::uint32_t)count,
+        total,
+    };
+
+    bool ok = write_all(fd, &header, sizeof(header));
+    if (count == RECORDER_CAPACITY) {
+        ok = ok && write_all(fd, ring.data() + head,
+                             (RECORDER_CAPACITY - head) * sizeof(Record));
+        ok = ok && write_all(fd, ring.data(), head * sizeof(Record));
+    } else {
+        ok = ok && write_all(fd, ring.data(), count * sizeof(Record));
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+bool dump() { return dump(get_dump_path()); }
+
+const char *get_dump_path() {
+    if (dump_path[0] == '\0') {
+        const char *dir = std::getenv("XDG_RUNTIME_DIR");
+        std::snprintf(dump_path, sizeof(dump_path), "%s/swayfire-%d.rec",
+                      dir ? dir : "/tmp", (int)getpid());
+    }
+    return dump_path;
+}
+
+/// Dump the ring then hand the signal over to the previous handler.
+static void on_fatal_signal(int sig) {
+    (void)dump(dump_path);
+
+    for (std::size_t i = 0; i < FATAL_SIGNALS.size(); i++)
+        if (FATAL_SIGNALS[i] == sig)
+            sigaction(sig, &old_actions[i], nullptr);
+
+    raise(sig);
+}
+
+void install_crash_handlers() {
+    if (install_count++ > 0)
+        return;
+
+    // Signal handlers can't compute it safely.
+    (void)get_dump_path();
+
+    struct sigaction action {};
+    action.sa_handler = on_fatal_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+
+    for (std::size_t i = 0; i < FATAL_SIGNALS.size(); i++)
+        sigaction(FATAL_SIGNALS[i], &action, &old_actions[i]);
+}
+
+void uninstall_crash_handlers() {
+    if (install_count == 0 || --install_count > 0)
+        return;
+
+    for (std::size_t i = 0; i < FATAL_SIGNALS.size(); i++)
+        sigaction(FATAL_SIGNALS[i], &old_actions[i], nullptr);
+}
+
+} // namespace recorder
@@ -0,0 +1,85 @@
+#ifndef SWAYFIRE_RECORDER_HPP
+#define SWAYFIRE_RECORDER_HPP
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <wayfire/geometry.hpp>
+
+/// Flight recorder of the operations applied on the node trees.
+///
+/// Records are kept in a fixed-size ring buffer allocated statically, so
+/// recording never allocates nor formats anything and stays enabled in release
+/// builds. The ring is dumped as raw binary records on demand, and on fatal
+/// signals (including SIGABRT from failed assertions).
+namespace recorder {
+
+/// The type of a recorded operation.
+enum struct RecordType : std::uint8_t {
+    VIEW_ATTACHED,    ///< A view node was attached. arg: packed wsid.
+    INSERT_CHILD,     ///< node inserted in split other.
+    REMOVE_CHILD,     ///< node removed from split other.
+    SWAP_CHILD,       ///< node replaced other in its parent.
+    SWAP_CHILDREN,    ///< node and other were swapped in their parent.
+    SET_SPLIT_TYPE,   ///< arg: the new split type.
+    INSERT_FLOATING,  ///< node inserted as floating. arg: packed wsid.
+    REMOVE_FLOATING,  ///< node removed from floating. arg: packed wsid.
+    SET_ACTIVE,       ///< node became active, replacing other.
+    CONFIGURE,        ///< node sent a configure to its client.
+    CONFIGURE_QUEUED, ///< node queued a configure behind an unacked one.
+    CONFIGURE_ACKED,  ///< The client of node acked or timed out.
+    MOVE_BEGIN,       ///< Floating move grab of node began.
+    TILED_MOVE_BEGIN, ///< Tiled move grab of node began.
+    RESIZE_BEGIN,     ///< Resize grab of node began. arg: the edges.
+    GRAB_END,         ///< The active grab ended.
+    DROP,             ///< node dropped on other. arg: the drop zone.
+};
+
+/// A single compact binary record.
+struct Record {
+    std::uint64_t time_ns; ///< CLOCK_MONOTONIC timestamp.
+    std::uint32_t node;    ///< The id of the subject node, 0 if none.
+    std::uint32_t other;   ///< The id of a related node, 0 if none.
+    wf::geometry_t geo;    ///< A geometry relevant to the operation.
+    std::uint32_t arg;     ///< Operation specific argument.
+    RecordType type;       ///< The recorded operation.
+};
+
+static_assert(std::is_trivially_copyable_v<Record>,
+              "Records are dumped as raw bytes.");
+
+/// The amount of records kept. Must be a power of two.
+constexpr std::size_t RECORDER_CAPACITY = 4096;
+
+/// Append a record to the ring, overwriting the oldest one if full.
+void record(RecordType type, std::uint32_t node, std::uint32_t other = 0,
+            wf::geometry_t geo = {0, 0, 0, 0}, std::uint32_t arg = 0);
+
+/// Pack a wsid into a record argument.
+constexpr std::uint32_t pack_wsid(wf::point_t wsid) {
+    return ((std::uint32_t)wsid.x << 16) | ((std::uint32_t)wsid.y & 0xffff);
+}
+
+/// Dump the recorded records, oldest first, to the given path.
+///
+/// Only uses async-signal-safe calls.
+bool dump(const char *path);
+
+/// Dump the recorded records to the default dump path.
+bool dump();
+
+/// Get the default dump path: $XDG_RUNTIME_DIR/swayfire-<pid>.rec.
+[[nodiscard]] const char *get_dump_path();
+
+/// Install handlers dumping the ring on fatal signals. Installs are counted,
+/// the handlers are installed by the first one.
+void install_crash_handlers();
+
+/// Restore the previous fatal signal handlers once uninstalled as many times
+/// as installed.
+void uninstall_crash_handlers();
+
+} // namespace recorder
+
+#endif // ifndef SWAYFIRE_RECORDER_HPP
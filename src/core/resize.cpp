@@ -41,6 +41,8 @@ int32_t SplitNode::try_move_edge(SplitChildIter child, std::int32_t delta,
     const bool outer_edge = ((front && child == children.begin()) ||
                              (!front && child == children.end() - 1));
 
+    const bool horizontal = split_type == SplitType::VSPLIT;
+
     if (outer_edge) {
         const auto geo = get_geometry();
         const std::int32_t size =
@@ -56,8 +58,9 @@ int32_t SplitNode::try_move_edge(SplitChildIter child, std::int32_t delta,
             delta_size = std::max(size + delta_size, pref_size) - size;
         }
 
-        delta_size = std::max(size + delta_size,
-                              (std::int32_t)children.size() * MIN_VIEW_SIZE) -
+        delta_size = std::clamp(size + delta_size,
+                                get_constraints().get_min(horizontal),
+                                get_constraints().get_max(horizontal)) -
                      size;
 
         if (delta_size == 0)
@@ -86,10 +89,13 @@ int32_t SplitNode::try_move_edge(SplitChildIter child, std::int32_t delta,
                 if (delta_size == 0)
                     return true;
 
-                std::int32_t old_csize = c.size;
-                c.size = (std::uint32_t)std::max(MIN_VIEW_SIZE,
-                                                 old_csize + delta_size);
-                delta_size -= c.size - old_csize;
+                const auto &cons = c.node->get_constraints();
+                const std::int32_t old_csize = c.size;
+                const std::int32_t new_csize = std::clamp(
+                    old_csize + delta_size, cons.get_min(horizontal),
+                    cons.get_max(horizontal));
+                c.size = (std::uint32_t)new_csize;
+                delta_size -= new_csize - old_csize;
                 return false;
             };
 
@@ -124,11 +130,18 @@ int32_t SplitNode::try_move_edge(SplitChildIter child, std::int32_t delta,
                 other_size - std::min(other_size - delta_child_size, pref);
         }
 
-        delta_child_size =
-            other_size - std::max(other_size - delta_child_size, MIN_VIEW_SIZE);
+        const auto &child_cons = child->node->get_constraints();
+        const auto &other_cons = other->node->get_constraints();
 
         delta_child_size =
-            std::max(child_size + delta_child_size, MIN_VIEW_SIZE) - child_size;
+            other_size - std::clamp(other_size - delta_child_size,
+                                    other_cons.get_min(horizontal),
+                                    other_cons.get_max(horizontal));
+
+        delta_child_size = std::clamp(child_size + delta_child_size,
+                                      child_cons.get_min(horizontal),
+                                      child_cons.get_max(horizontal)) -
+                           child_size;
 
         child->size += delta_child_size;
         other->size -= delta_child_size;
@@ -150,7 +163,7 @@ wf::dimensions_t SplitNode::try_resize_child(Node node, wf::dimensions_t ndims,
 
     const auto child_geo = child->node->get_geometry();
 
-    ndims = nonwf::max(ndims, {MIN_VIEW_SIZE, MIN_VIEW_SIZE});
+    ndims = node->get_constraints().clamp(ndims);
 
     wf::dimensions_t delta = {
         ndims.width - child_geo.width,
@@ -247,6 +260,7 @@ wf::dimensions_t Workspace::try_resize_child(Node child, wf::dimensions_t ndims,
                                              std::uint32_t edges) {
     if (child->get_floating()) {
         auto ngeo = child->get_geometry();
+        ndims = child->get_constraints().clamp(ndims);
 
         auto hori_locked = (edges & (WLR_EDGE_LEFT | WLR_EDGE_RIGHT)) == 0;
         auto vert_locked = (edges & (WLR_EDGE_TOP | WLR_EDGE_BOTTOM)) == 0;
@@ -0,0 +1,385 @@
+#include "core.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <string_view>
+#include <wayfire/config.h>
+#include <wayfire/nonstd/wlroots-full.hpp>
+
+// RuleActions
+
+void RuleActions::merge(const RuleActions &other) {
+    if (other.wsid)
+        wsid = other.wsid;
+    if (other.floating)
+        floating = other.floating;
+    if (other.size)
+        size = other.size;
+    if (other.layout)
+        layout = other.layout;
+    if (other.split)
+        split = other.split;
+}
+
+// Rule parsing
+
+/// Skip the leading whitespace of s.
+static void skip_space(std::string_view &s) {
+    while (!s.empty() && std::isspace((unsigned char)s.front()))
+        s.remove_prefix(1);
+}
+
+/// Consume c if it is the first character of s.
+static bool consume(std::string_view &s, char c) {
+    if (s.empty() || s.front() != c)
+        return false;
+
+    s.remove_prefix(1);
+    return true;
+}
+
+/// Consume the leading criterion key of s.
+static std::string_view parse_key(std::string_view &s) {
+    std::size_t len = 0;
+    while (len < s.size() && (std::isalnum((unsigned char)s[len]) ||
+                              s[len] == '_'))
+        len++;
+
+    const auto key = s.substr(0, len);
+    s.remove_prefix(len);
+    return key;
+}
+
+/// Consume the leading double-quoted value of s, unescaping \".
+static std::optional<std::string> parse_quoted(std::string_view &s) {
+    if (!consume(s, '"'))
+        return std::nullopt;
+
+    std::string value;
+    while (!s.empty() && s.front() != '"') {
+        if (s.front() == '\\' && s.size() > 1 && s[1] == '"')
+            s.remove_prefix(1);
+
+        value.push_back(s.front());
+        s.remove_prefix(1);
+    }
+
+    if (!consume(s, '"'))
+        return std::nullopt;
+    return value;
+}
+
+/// Get the only string matched by pattern if it is anchored on both ends and
+/// has no other regex metacharacters.
+static std::optional<std::string> get_literal(const std::string &pattern) {
+    if (pattern.size() < 2 || pattern.front() != '^' || pattern.back() != '$')
+        return std::nullopt;
+
+    auto inner = pattern.substr(1, pattern.size() - 2);
+    if (inner.find_first_of(".[]{}()\\*+?|^$") != std::string::npos)
+        return std::nullopt;
+
+    return inner;
+}
+
+/// Parse an integer argument.
+static std::optional<int> parse_int(std::string_view s) {
+    int value = 0;
+    const auto *last = s.data() + s.size();
+    const auto [end, err] = std::from_chars(s.data(), last, value);
+    if (err != std::errc() || end != last)
+        return std::nullopt;
+    return value;
+}
+
+/// Parse a split type argument.
+static std::optional<SplitType> parse_split_type(std::string_view s) {
+    if (s == "vsplit")
+        return SplitType::VSPLIT;
+    if (s == "hsplit")
+        return SplitType::HSPLIT;
+    if (s == "tabbed")
+        return SplitType::TABBED;
+    if (s == "stacked")
+        return SplitType::STACKED;
+    return std::nullopt;
+}
+
+/// Parse a single action made of whitespace separated arguments.
+static bool parse_action(std::string_view s, RuleActions &actions) {
+    std::vector<std::string_view> args;
+    while (true) {
+        skip_space(s);
+        if (s.empty())
+            break;
+
+        std::size_t len = 0;
+        while (len < s.size() && !std::isspace((unsigned char)s[len]))
+            len++;
+        args.push_back(s.substr(0, len));
+        s.remove_prefix(len);
+    }
+
+    if (args.empty())
+        return true;
+
+    const auto cmd = args[0];
+
+    if (cmd == "floating" && args.size() == 2) {
+        if (args[1] != "enable" && args[1] != "disable")
+            return false;
+
+        actions.floating = args[1] == "enable";
+        return true;
+    }
+
+    if ((cmd == "workspace" || cmd == "resize") && args.size() == 3) {
+        const auto a = parse_int(args[1]);
+        const auto b = parse_int(args[2]);
+        if (!a || !b)
+            return false;
+
+        if (cmd == "workspace") {
+            actions.wsid = {*a, *b};
+        } else {
+            if (*a < MIN_VIEW_SIZE || *b < MIN_VIEW_SIZE)
+                return false;
+            actions.size = {*a, *b};
+        }
+        return true;
+    }
+
+    if (cmd == "layout" && args.size() == 2) {
+        actions.layout = parse_split_type(args[1]);
+        return actions.layout.has_value();
+    }
+
+    if (cmd == "split" && args.size() == 2) {
+        actions.split = parse_split_type(args[1]);
+        return actions.split == SplitType::VSPLIT ||
+               actions.split == SplitType::HSPLIT;
+    }
+
+    return false;
+}
+
+/// Parse and compile a rule of the form: [key="regex" ...] action, action...
+static std::optional<WindowRule> parse_rule(const std::string &name,
+                                            std::string_view src) {
+    const auto fail = [&](const std::string &why) {
+        LOGE("Invalid window rule ", name, ": ", why);
+        return std::nullopt;
+    };
+
+    WindowRule rule;
+
+    skip_space(src);
+    if (!consume(src, '['))
+        return fail("expected [criteria]");
+
+    while (true) {
+        skip_space(src);
+        if (consume(src, ']'))
+            break;
+
+        const std::string key(parse_key(src));
+        skip_space(src);
+        if (key.empty() || !consume(src, '='))
+            return fail("expected key=\"value\" in criteria");
+
+        skip_space(src);
+        const auto value = parse_quoted(src);
+        if (!value)
+            return fail("expected a quoted value for " + key);
+
+        std::optional<std::regex> *criterion = nullptr;
+        if (key == "app_id") {
+            // Literal app_ids are matched through a hash lookup instead.
+            if ((rule.app_id_literal = get_literal(*value)))
+                continue;
+            criterion = &rule.app_id;
+        } else if (key == "title") {
+            criterion = &rule.title;
+        } else if (key == "class") {
+            criterion = &rule.window_class;
+        } else if (key == "window_role") {
+            criterion = &rule.window_role;
+        } else {
+            return fail("unknown criterion " + key);
+        }
+
+        try {
+            *criterion = std::regex(*value, std::regex::ECMAScript |
+                                                std::regex::optimize);
+        } catch (const std::regex_error &e) {
+            return fail("invalid regex \"" + *value + "\": " + e.what());
+        }
+    }
+
+    bool has_action = false;
+    while (true) {
+        skip_space(src);
+        if (src.empty())
+            break;
+
+        const auto end = std::min(src.find_first_of(",;"), src.size());
+        const auto action = src.substr(0, end);
+        src.remove_prefix(std::min(end + 1, src.size()));
+
+        if (!parse_action(action, rule.actions))
+            return fail("invalid action \"" + std::string(action) + "\"");
+        has_action = true;
+    }
+
+    if (!has_action)
+        return fail("no actions");
+
+    return rule;
+}
+
+// Rule matching
+
+/// The X11 properties of a view matched by rules.
+struct X11Props {
+    std::optional<std::string> window_class;
+    std::optional<std::string> window_role;
+};
+
+/// Get the X11 properties of a view, which are unset for non-X11 views.
+static X11Props get_x11_props(wayfire_view view) {
+    X11Props props;
+#if WF_HAS_XWAYLAND
+    const auto surface = view->get_wlr_surface();
+    if (surface && wlr_surface_is_xwayland_surface(surface)) {
+        const auto xsurface = wlr_xwayland_surface_from_wlr_surface(surface);
+        props.window_class = xsurface->class_t ? xsurface->class_t : "";
+        props.window_role = xsurface->role ? xsurface->role : "";
+    }
+#else
+    (void)view;
+#endif
+    return props;
+}
+
+/// Check whether the optional criterion matches the optional value.
+static bool criterion_matches(const std::optional<std::regex> &criterion,
+                              const std::optional<std::string> &value) {
+    if (!criterion)
+        return true;
+    return value && std::regex_search(*value, *criterion);
+}
+
+// WindowRules
+
+void WindowRules::compile(
+    const wf::config::compound_list_t<std::string> &sources) {
+    rules.clear();
+    by_app_id.clear();
+    generic.clear();
+
+    for (const auto &[name, source] : sources) {
+        auto rule = parse_rule(name, source);
+        if (!rule)
+            continue;
+
+        const auto i = rules.size();
+        if (rule->app_id_literal)
+            by_app_id[*rule->app_id_literal].push_back(i);
+        else
+            generic.push_back(i);
+
+        rules.push_back(std::move(*rule));
+    }
+}
+
+RuleActions WindowRules::match(wayfire_view view) const {
+    RuleActions actions;
+    if (rules.empty())
+        return actions;
+
+    const std::optional<std::string> app_id = view->get_app_id();
+    const std::optional<std::string> title = view->get_title();
+    const auto x11 = get_x11_props(view);
+
+    static const std::vector<std::size_t> none;
+    const auto literal_it = by_app_id.find(*app_id);
+    const auto &literal =
+        literal_it == by_app_id.end() ? none : literal_it->second;
+
+    // Both index lists are sorted: walk them in config order so that later
+    // rules override earlier ones.
+    std::size_t l = 0, g = 0;
+    while (l < literal.size() || g < generic.size()) {
+        const bool take_literal =
+            g == generic.size() ||
+            (l < literal.size() && literal[l] < generic[g]);
+        const auto &rule = rules[take_literal ? literal[l++] : generic[g++]];
+
+        if (criterion_matches(rule.app_id, app_id) &&
+            criterion_matches(rule.title, title) &&
+            criterion_matches(rule.window_class, x11.window_class) &&
+            criterion_matches(rule.window_role, x11.window_role))
+            actions.merge(rule.actions);
+    }
+
+    return actions;
+}
+
+// Swayfire
+
+void Swayfire::attach_view(wayfire_view view) {
+    auto node = init_view_node(view);
+
+    // Like sway, only place views by the rules when they are first mapped:
+    // not again when they are unminimized or come from another output.
+    RuleActions actions;
+    if (!view->has_data<RulesAppliedData>()) {
+        actions = rules.match(view);
+        view->store_data(std::make_unique<RulesAppliedData>());
+    }
+
+    auto wsid = nonwf::get_view_workspace(view);
+    if (actions.wsid) {
+        if (workspaces.contains(*actions.wsid))
+            wsid = *actions.wsid;
+        else
+            LOGE("Window rule workspace ", *actions.wsid,
+                 " is outside of the workspace grid");
+    }
+    auto ws = workspaces.get(wsid);
+
+    recorder::record(recorder::RecordType::VIEW_ATTACHED, node->get_id(), 0,
+                     view->get_wm_geometry(), recorder::pack_wsid(wsid));
+
+    if (actions.split)
+        node->set_prefered_split_type(actions.split);
+
+    if (actions.floating.value_or(false)) {
+        if (actions.size) {
+            const auto wa = ws->workarea;
+            node->set_floating_geometry({
+                wa.x + (wa.width - actions.size->width) / 2,
+                wa.y + (wa.height - actions.size->height) / 2,
+                actions.size->width,
+                actions.size->height,
+            });
+        }
+
+        ws->insert_floating_node(std::move(node));
+    } else {
+        // Insert and re-split in a single layout pass.
+        ws->batch_layout([&]() {
+            const Node node_ref = node.get();
+            ws->insert_tiled_node(std::move(node));
+
+            if (actions.layout)
+                if (auto parent = node_ref->parent->as_split_node())
+                    parent->set_split_type(*actions.layout);
+        });
+    }
+
+    // The layout of hidden workspaces is deferred, which would leave the view
+    // on the current one. Move it to its workspace right away.
+    ws->flush_pending_layout();
+}
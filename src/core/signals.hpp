@@ -49,6 +49,13 @@ struct RootNodeChangedSignalData {
     Node old_root, new_root;
 };
 
+/// NAME: swf-ws-urgency-changed
+/// ON: output
+/// WHEN: When the amount of urgent views in a workspace of the output changes.
+struct WorkspaceUrgencyChangedSignal {
+    WorkspaceRef workspace;
+};
+
 // ========================================================================== //
 // == Node Lifecycle ==
 
@@ -85,6 +92,16 @@ struct TitleChangedSignal {};
 /// WHEN: When the node's padding changes.
 struct PaddingChangedSignal {};
 
+/// NAME: urgency-changed
+/// ON: INode
+/// WHEN: When the amount of urgent views in the node's subtree changes.
+struct UrgencyChangedSignal {};
+
+/// NAME: ws-changed
+/// ON: INode
+/// WHEN: When the node is moved to another workspace.
+struct WorkspaceChangedSignal {};
+
 // ========================================================================== //
 // == View Node Signals ==
 
@@ -127,6 +144,15 @@ struct ChildSwappedSignalData {
 struct ChildrenSwappedSignal {
 };
 
+/// NAME: child-urgency-changed
+/// ON: SplitNode
+/// WHEN: When the amount of urgent views under a direct child of the node
+/// changes while it stays a child.
+struct ChildUrgencyChangedSignal {
+    /// The child whose urgency changed.
+    Node node;
+};
+
 /// NAME: split-type-changed
 /// ON: SplitNode
 /// WHEN: When the split type of the node changes.
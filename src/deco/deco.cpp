@@ -99,6 +99,15 @@ void DecorationSurface::set_size(wf::dimensions_t view_size) {
     recalculate_region();
 }
 
+void DecorationSurface::set_outer_corners(Corners corners) {
+    if (outer_corners == corners)
+        return;
+
+    // The region follows the rounding of the corners.
+    outer_corners = corners;
+    recalculate_region();
+}
+
 void DecorationSurface::recalculate_region() {
     cached_region = BorderSubSurf::calculate_region(get_border_spec());
 }
@@ -111,27 +120,34 @@ void DecorationSurface::simple_render(const wf::framebuffer_t &fb, int x, int y,
                                       const wf::region_t &damage) {
     const wf::region_t region = cached_region + wf::point_t{x, y};
     const auto spec = get_border_spec();
+    const auto color_set =
+        node->is_urgent() ? &options->colors.urgent : colors.get();
     const auto color_spec = BorderSubSurf::Colors{
         // all
-        colors->child_border,
+        color_set->child_border,
 
         // right
         node->get_prefered_split_type() == SplitType::VSPLIT
-            ? colors->indicator.value()
-            : colors->child_border.value(),
+            ? color_set->indicator.value()
+            : color_set->child_border.value(),
 
         // bottom
         node->get_prefered_split_type() == SplitType::HSPLIT
-            ? colors->indicator.value()
-            : colors->child_border.value(),
+            ? color_set->indicator.value()
+            : color_set->child_border.value(),
     };
 
+    auto &perf = node->get_ws()->plugin->perf;
+
     OpenGL::render_begin(fb);
     for (const auto &scissor : region &damage) {
         fb.logic_scissor(wlr_box_from_pixman_box(scissor));
 
         BorderSubSurf::render(spec, color_spec, {x, y},
                               fb.get_orthographic_projection());
+
+        if (perf.enabled)
+            perf.draw_calls++;
     }
 
     OpenGL::render_end();
@@ -139,88 +155,120 @@ void DecorationSurface::simple_render(const wf::framebuffer_t &fb, int x, int y,
 
 // SplitDecoration
 
-#define WITH_TABS_SPEC_IMPL                                                    \
-    const auto count = tab_surfaces.size();                                    \
-    const int border_radius = options->border_radius;                          \
-    int offset = 0;                                                            \
-                                                                               \
-    if (node->get_split_type() == SplitType::TABBED) {                         \
-        for (std::size_t i = 0; i < count; i++) {                              \
-            const TitleBarSubSurf::Spec spec = {                               \
-                wf::geometry_t{                                                \
-                    offset,                                                    \
-                    0,                                                         \
-                    i == count - 1                                             \
-                        ? geometry.width - offset                              \
-                        : (int)((std::size_t)geometry.width / count),          \
-                    geometry.height,                                           \
-                },                                                             \
-                {                                                              \
-                    (i == 0 && outer_corners & Corner::TOP_LEFT)               \
-                        ? border_radius                                        \
-                        : 0,                                                   \
-                    (i == count - 1 && outer_corners & Corner::TOP_RIGHT)      \
-                        ? border_radius                                        \
-                        : 0,                                                   \
-                }};                                                            \
-                                                                               \
-            f(tab_surfaces[i], spec);                                          \
-            offset += (int)((std::size_t)geometry.width / count);              \
-        }                                                                      \
-    } else if (node->get_split_type() == SplitType::STACKED) {                 \
-        for (std::size_t i = 0; i < count; i++) {                              \
-            const TitleBarSubSurf::Spec spec = {                               \
-                wf::geometry_t{                                                \
-                    0,                                                         \
-                    (int)i * 20,                                               \
-                    geometry.width,                                            \
-                    20,                                                        \
-                },                                                             \
-                {                                                              \
-                    (i == 0 && outer_corners & Corner::TOP_LEFT)               \
-                        ? border_radius                                        \
-                        : 0,                                                   \
-                    (i == 0 && outer_corners & Corner::TOP_RIGHT)              \
-                        ? border_radius                                        \
-                        : 0,                                                   \
-                }};                                                            \
-                                                                               \
-            f(tab_surfaces[i], spec);                                          \
-        }                                                                      \
-    }
+/// The height of a single tab in the titlebar.
+constexpr int TAB_HEIGHT = 20;
+
+void SplitDecoration::recalculate_tab_specs() {
+    const auto count = tab_surfaces.size();
+    const int border_radius = options->border_radius;
+
+    tab_specs.clear();
+    tab_specs.reserve(count);
+
+    if (count == 0)
+        return;
 
-void SplitDecoration::with_tabs_spec(
-    const std::function<void(TitleBarSubSurf &tab, TitleBarSubSurf::Spec)> &f) {
-    WITH_TABS_SPEC_IMPL;
+    if (node->get_split_type() == SplitType::TABBED) {
+        const int tab_width = (int)((std::size_t)geometry.width / count);
+        for (std::size_t i = 0; i < count; i++) {
+            const int offset = (int)i * tab_width;
+            tab_specs.push_back({
+                wf::geometry_t{
+                    offset,
+                    0,
+                    i == count - 1 ? geometry.width - offset : tab_width,
+                    geometry.height,
+                },
+                {
+                    (i == 0 && outer_corners & Corner::TOP_LEFT)
+                        ? border_radius
+                        : 0,
+                    (i == count - 1 && outer_corners & Corner::TOP_RIGHT)
+                        ? border_radius
+                        : 0,
+                },
+            });
+        }
+    } else if (node->get_split_type() == SplitType::STACKED) {
+        for (std::size_t i = 0; i < count; i++) {
+            tab_specs.push_back({
+                wf::geometry_t{
+                    0,
+                    (int)i * TAB_HEIGHT,
+                    geometry.width,
+                    TAB_HEIGHT,
+                },
+                {
+                    (i == 0 && outer_corners & Corner::TOP_LEFT)
+                        ? border_radius
+                        : 0,
+                    (i == 0 && outer_corners & Corner::TOP_RIGHT)
+                        ? border_radius
+                        : 0,
+                },
+            });
+        }
+    }
 }
-void SplitDecoration::with_tabs_spec(
-    const std::function<void(const TitleBarSubSurf &tab, TitleBarSubSurf::Spec)>
-        &f) const {
-    WITH_TABS_SPEC_IMPL;
+
+std::optional<std::size_t> SplitDecoration::tab_at(wf::point_t p) const {
+    if (tab_specs.empty() || p.x < 0 || p.y < 0 || p.x >= geometry.width ||
+        p.y >= geometry.height)
+        return std::nullopt;
+
+    const auto count = tab_specs.size();
+    std::size_t i = 0;
+
+    if (node->get_split_type() == SplitType::TABBED) {
+        // All tabs but the last have the same width, the last one taking the
+        // remainder.
+        const auto tab_width = tab_specs.front().geo.width;
+        i = tab_width > 0 ? (std::size_t)(p.x / tab_width) : count - 1;
+    } else {
+        i = (std::size_t)(p.y / TAB_HEIGHT);
+    }
+
+    return std::min(i, count - 1);
 }
-#undef WITH_TABS_SPEC_IMPL
 
 void SplitDecoration::cache_textures() {
     assert(node->get_children_count() == tab_surfaces.size());
 
+    // Titles are rasterized at the buffer scale of the output the node is on,
+    // so they only get re-rasterized when it lands on an output with a
+    // different scale.
+    const float scale = node->get_ws()->output->handle->scale;
+    auto &perf = node->get_ws()->plugin->perf;
+
     OpenGL::render_begin();
-    std::size_t i = 0;
-    with_tabs_spec([&](TitleBarSubSurf &tab, const auto spec) {
+    for (std::size_t i = 0; i < tab_specs.size(); i++) {
         const auto child = node->child_at(i);
         const std::string title = child->get_title();
 
-        tab.cache_textures({
-            spec,
+        const bool uploaded = tab_surfaces[i].cache_textures({
+            tab_specs[i],
+            scale,
             options->title_font.value(),
             title,
             wf::color_t(1, 1, 1, 1),
         });
-        i++;
-    });
+
+        if (uploaded && perf.enabled)
+            perf.texture_uploads++;
+    }
     OpenGL::render_end();
     damage();
 }
 
+void SplitDecoration::damage_tab(std::size_t i) {
+    if (i >= tab_specs.size())
+        return;
+
+    const auto og = get_output_geometry();
+    node->get_ws()->output->render->damage(tab_specs[i].geo +
+                                           wf::point_t{og.x, og.y});
+}
+
 void SplitDecoration::set_size(wf::dimensions_t dims) {
     damage();
     geometry = {
@@ -229,6 +277,7 @@ void SplitDecoration::set_size(wf::dimensions_t dims) {
         dims.width,
         dims.height,
     };
+    recalculate_tab_specs();
     cache_textures();
     cached_region = calculate_region();
 
@@ -249,9 +298,8 @@ void SplitDecoration::set_size(wf::dimensions_t dims) {
 wf::region_t SplitDecoration::calculate_region() const {
     wf::region_t region;
 
-    with_tabs_spec([&](const auto &tab, const auto spec) {
-        region |= tab.calculate_region(spec);
-    });
+    for (std::size_t i = 0; i < tab_specs.size(); i++)
+        region |= tab_surfaces[i].calculate_region(tab_specs[i]);
 
     return region;
 }
@@ -260,6 +308,7 @@ void SplitDecoration::on_child_inserted_impl(ChildInsertedSignal *data) {
     data->node->connect(&on_title_changed);
 
     tab_surfaces.emplace_back();
+    recalculate_tab_specs();
 
     if (node->get_split_type() == SplitType::STACKED)
         refresh_size();
@@ -293,6 +342,7 @@ void SplitDecoration::on_child_removed_impl(ChildRemovedSignal *data) {
     }
 
     tab_surfaces.pop_back();
+    recalculate_tab_specs();
 
     if (node->get_split_type() == SplitType::STACKED)
         refresh_size();
@@ -302,13 +352,25 @@ void SplitDecoration::on_child_removed_impl(ChildRemovedSignal *data) {
     ::set_outer_corners(node, outer_corners);
 }
 
+void SplitDecoration::on_child_urgency_changed_impl(
+    ChildUrgencyChangedSignal *data) {
+    // Only the tab of the child changes color.
+    for (std::size_t i = 0; i < node->get_children_count(); i++) {
+        if (node->child_at(i) == data->node) {
+            damage_tab(i);
+            return;
+        }
+    }
+}
+
 void SplitDecoration::refresh_size() {
     switch (node->get_split_type()) {
     case SplitType::TABBED:
-        set_size({geometry.width, 20});
+        set_size({geometry.width, TAB_HEIGHT});
         break;
     case SplitType::STACKED:
-        set_size({geometry.width, 20 * (int)node->get_children_count()});
+        set_size(
+            {geometry.width, TAB_HEIGHT * (int)node->get_children_count()});
         break;
 
     default:
@@ -317,6 +379,15 @@ void SplitDecoration::refresh_size() {
     }
 }
 
+void SplitDecoration::set_outer_corners(Corners corners) {
+    if (outer_corners == corners)
+        return;
+
+    outer_corners = corners;
+    recalculate_tab_specs();
+    cached_region = calculate_region();
+}
+
 void SplitDecoration::on_set_active(bool active) {
     node_state.is_active = active;
     damage();
@@ -334,13 +405,9 @@ wf::dimensions_t SplitDecoration::get_size() const {
 }
 
 bool SplitDecoration::accepts_input(std::int32_t sx, std::int32_t sy) {
-    bool r = false;
-
-    with_tabs_spec([&](const auto &tab, const auto spec) {
-        r = r || tab.contains_point(spec, {sx, sy});
-    });
-
-    return r;
+    // Only the tab under the point can contain it.
+    const auto i = tab_at({sx, sy});
+    return i && tab_surfaces[*i].contains_point(tab_specs[*i], {sx, sy});
 }
 
 void SplitDecoration::simple_render(const wf::framebuffer_t &fb, int x, int y,
@@ -355,31 +422,35 @@ void SplitDecoration::simple_render(const wf::framebuffer_t &fb, int x, int y,
     const wf::color_t focused_color_spec = colors.focused.child_border;
     const wf::color_t focused_inctive_color_spec =
         colors.focused_inactive.child_border;
+    const wf::color_t urgent_color_spec = colors.urgent.child_border;
 
     const wf::region_t region = cached_region + wf::point_t{x, y};
+    auto &perf = node->get_ws()->plugin->perf;
 
     OpenGL::render_begin(fb);
     for (const auto &scissor : region &damage) {
         fb.logic_scissor(wlr_box_from_pixman_box(scissor));
 
         const auto matrix = fb.get_orthographic_projection();
+        if (perf.enabled)
+            perf.draw_calls++;
 
-        std::size_t i = 0;
-        with_tabs_spec([&](const auto &tab, const auto spec) {
+        for (std::size_t i = 0; i < tab_specs.size(); i++) {
             const auto child = node->child_at(i);
             auto color = unfocused_color_spec;
 
             if (node_state.is_active || active_node == child)
                 color = focused_color_spec;
+            else if (child->is_urgent())
+                color = urgent_color_spec;
             else if (node_state.is_child_active &&
                      node->get_active_child() == child)
                 color = focused_inctive_color_spec;
             else
                 color = unfocused_color_spec;
 
-            tab.render(spec, color, {x, y}, matrix);
-            i++;
-        });
+            tab_surfaces[i].render(tab_specs[i], color, {x, y}, matrix);
+        }
     }
 
     OpenGL::render_end();
@@ -548,6 +619,9 @@ void SwayfireDeco::swf_init() {
       ConfigChangedSignal sig = {};
       output->emit(&sig);
     });
+
+    perf_hud = std::make_unique<PerfHud>(output, swayfire);
+    output->add_activator(options.perf_hud, &on_toggle_perf_hud);
 }
 
 void SwayfireDeco::swf_fini() {
@@ -559,6 +633,9 @@ void SwayfireDeco::swf_fini() {
     output->disconnect(&on_split_node_created);
     output->disconnect(&on_view_node_attached);
 
+    output->rem_binding(&on_toggle_perf_hud);
+    perf_hud.reset();
+
     subsurf_gl_fini();
 }
 
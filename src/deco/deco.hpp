@@ -10,6 +10,7 @@
 #include "../core/core.hpp"
 #include "../core/plugin.hpp"
 #include "../core/signals.hpp"
+#include "hud.hpp"
 #include "subsurf.hpp"
 
 struct DecorationColors {
@@ -33,6 +34,8 @@ struct Options {
     // wf::option_wrapper_t<int> title_bar_height{
     // "swayfire-deco/title_bar_height"};
     wf::option_wrapper_t<std::string> title_font{"swayfire-deco/title_font"};
+    wf::option_wrapper_t<wf::activatorbinding_t> perf_hud{
+        "swayfire-deco/perf_hud"};
 
     struct DecoColorSets {
         /// Focused deco color set.
@@ -59,6 +62,14 @@ struct Options {
             {"swayfire-deco/unfocused.indicator"},
             {"swayfire-deco/unfocused.child_border"},
         };
+        /// Urgent deco color set.
+        DecorationColors urgent{
+            {"swayfire-deco/urgent.border"},
+            {"swayfire-deco/urgent.background"},
+            {"swayfire-deco/urgent.text"},
+            {"swayfire-deco/urgent.indicator"},
+            {"swayfire-deco/urgent.child_border"},
+        };
 
         // TODO: implement other i3 class colors
     } colors;
@@ -73,6 +84,7 @@ struct Options {
         colors.focused.set_callback(cb);
         colors.focused_inactive.set_callback(cb);
         colors.unfocused.set_callback(cb);
+        colors.urgent.set_callback(cb);
     }
 };
 
@@ -146,7 +158,7 @@ class DecorationSurface final : public wf::touch_interaction_t,
     [[nodiscard]] Corners get_outer_corners() const { return outer_corners; };
 
     /// Set the outer corners of the splitnode.
-    void set_outer_corners(Corners corners) { outer_corners = corners; };
+    void set_outer_corners(Corners corners);
 
     /// Set the size of the surface.
     void set_size(wf::dimensions_t view_size);
@@ -190,6 +202,9 @@ class ViewDecoration final : public wf::decorator_frame_t_t {
     wf::signal::connection_t<PreferredSplitSignal> on_prefered_split_type_changed =
         [&](PreferredSplitSignal *) { damage(); };
 
+    wf::signal::connection_t<UrgencyChangedSignal> on_urgency_changed =
+        [&](UrgencyChangedSignal *) { damage(); };
+
     wf::signal::connection_t<ConfigChangedSignal> on_config_changed = [&](ConfigChangedSignal *) {
         // Refresh geometry in case border_width changes.
         node->refresh_geometry();
@@ -236,6 +251,7 @@ class ViewDecoration final : public wf::decorator_frame_t_t {
 
         node->connect(&on_padding_changed);
         node->connect(&on_prefered_split_type_changed);
+        node->connect(&on_urgency_changed);
         node->connect(&on_detached);
         node->view->connect(&on_fullscreen);
 
@@ -266,6 +282,7 @@ class ViewDecoration final : public wf::decorator_frame_t_t {
 
         node->view->disconnect(&on_fullscreen);
         node->disconnect(&on_detached);
+        node->disconnect(&on_urgency_changed);
         node->disconnect(&on_prefered_split_type_changed);
         node->disconnect(&on_padding_changed);
     }
@@ -298,20 +315,23 @@ class SplitDecoration final : public wf::view_interface_t,
     /// The loaded options from the cfg.
     nonstd::observer_ptr<Options> options;
 
-    /// Run the given callback for every tab surface with it's respective
-    /// surface spec.
-    void with_tabs_spec(
-        const std::function<void(TitleBarSubSurf &, TitleBarSubSurf::Spec)> &);
+    /// The surface specs of the tabs: tab_specs[i] is the spec of
+    /// tab_surfaces[i].
+    std::vector<TitleBarSubSurf::Spec> tab_specs;
 
-    /// Run the given callback for every tab surface with it's respective
-    /// surface spec.
-    void
-    with_tabs_spec(const std::function<void(const TitleBarSubSurf &,
-                                            TitleBarSubSurf::Spec)> &) const;
+    /// Recompute the tab specs from the geometry, the children count and the
+    /// split type of the node.
+    void recalculate_tab_specs();
+
+    /// Get the index of the tab at the given surface-local point.
+    [[nodiscard]] std::optional<std::size_t> tab_at(wf::point_t p) const;
 
     /// Recalculate the cached surface textures.
     void cache_textures();
 
+    /// Damage the area of a single tab.
+    void damage_tab(std::size_t i);
+
     struct {
         /// Whether the node is active.
         bool is_active = false;
@@ -353,12 +373,52 @@ class SplitDecoration final : public wf::view_interface_t,
         // Refreshing the geometry may not actually change the geometry. (e.g.
         // If only border_radius changes) So we still need to update the
         // cached_region here.
+        recalculate_tab_specs();
         cached_region = calculate_region();
 
         // In case the font changes:
         cache_textures();
     };
 
+    wf::signal::connection_t<wf::output_configuration_changed_signal>
+        on_output_config_changed =
+            [&](wf::output_configuration_changed_signal *data) {
+                // Titles are rasterized at the buffer scale of the output.
+                if (data->changed_fields & wf::OUTPUT_SCALE_CHANGE)
+                    cache_textures();
+            };
+
+    /// The output the output signals are connected on.
+    OutputRef output = nullptr;
+
+    /// Connect the output signals on the output of the node.
+    void connect_output() {
+        output = node->get_ws()->output;
+        output->connect(&on_detached);
+        output->connect(&on_config_changed);
+        output->connect(&on_output_config_changed);
+    }
+
+    /// Disconnect the output signals from their output.
+    void disconnect_output() {
+        output->disconnect(&on_output_config_changed);
+        output->disconnect(&on_config_changed);
+        output->disconnect(&on_detached);
+    }
+
+    wf::signal::connection_t<WorkspaceChangedSignal> on_ws_changed =
+        [&](WorkspaceChangedSignal *) {
+            if (node->get_ws()->output == output)
+                return;
+
+            disconnect_output();
+            connect_output();
+
+            // The new output may have another scale.
+            cache_textures();
+            damage();
+        };
+
     wf::signal::connection_t<GeometryChangedSignalData> on_geometry_changed =
         [&](GeometryChangedSignalData *data) {
             {
@@ -383,6 +443,7 @@ class SplitDecoration final : public wf::view_interface_t,
                 geometry.height,
             };
 
+            recalculate_tab_specs();
             if (titlebar_size_changed)
                 cache_textures();
             cached_region = calculate_region();
@@ -429,6 +490,12 @@ class SplitDecoration final : public wf::view_interface_t,
         on_child_removed_impl(data);
     };
 
+    void on_child_urgency_changed_impl(ChildUrgencyChangedSignal *data);
+    wf::signal::connection_t<ChildUrgencyChangedSignal> on_child_urgency_changed =
+        [&](ChildUrgencyChangedSignal *data) {
+            on_child_urgency_changed_impl(data);
+        };
+
     wf::signal::connection_t<SplitTypeChangedSignal> on_split_type_changed = [&](SplitTypeChangedSignal *) {
         if (!node->is_stack() && is_visible())
             set_visible(false);
@@ -457,11 +524,11 @@ class SplitDecoration final : public wf::view_interface_t,
         node->connect(&on_child_swapped);
         node->connect(&on_children_swapped);
         node->connect(&on_child_removed);
+        node->connect(&on_child_urgency_changed);
         node->connect(&on_split_type_changed);
+        node->connect(&on_ws_changed);
 
-        const auto output = node->get_ws()->output;
-        output->connect(&on_detached);
-        output->connect(&on_config_changed);
+        connect_output();
 
         node->store_data(std::make_unique<SplitDecorationData>(this));
     }
@@ -475,11 +542,11 @@ class SplitDecoration final : public wf::view_interface_t,
                 node->child_at(i)->disconnect(&on_title_changed);
         }
 
-        const auto output = node->get_ws()->output;
-        output->disconnect(&on_config_changed);
-        output->disconnect(&on_detached);
+        disconnect_output();
 
+        node->disconnect(&on_ws_changed);
         node->disconnect(&on_split_type_changed);
+        node->disconnect(&on_child_urgency_changed);
         node->disconnect(&on_child_removed);
         node->disconnect(&on_children_swapped);
         node->disconnect(&on_child_swapped);
@@ -493,7 +560,7 @@ class SplitDecoration final : public wf::view_interface_t,
     }
 
     /// Set the outer corners of the splitnode.
-    void set_outer_corners(Corners corners) { outer_corners = corners; };
+    void set_outer_corners(Corners corners);
 
     /// Handle this node being (un)set as active in its workspace.
     void on_set_active(bool active);
@@ -575,6 +642,15 @@ class SwayfireDeco final : public SwayfirePlugin {
 
     Options options{};
 
+    /// The performance HUD of the output.
+    std::unique_ptr<PerfHud> perf_hud;
+
+    wf::activator_callback on_toggle_perf_hud = [&](auto) {
+        perf_hud->set_font(options.title_font);
+        perf_hud->toggle();
+        return true;
+    };
+
   public:
     // == Impl SwayfirePlugin ==
     void swf_init() override;
@@ -0,0 +1,171 @@
+#include "hud.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <wayfire/opengl.hpp>
+
+// PerfHud
+
+/// Interval in ms at which the counters are sampled.
+constexpr int HUD_SAMPLE_INTERVAL = 1000;
+
+/// The amount of slowest clients listed.
+constexpr std::size_t HUD_SLOWEST_CLIENTS = 3;
+
+/// The logical height of a line of the HUD.
+constexpr int HUD_LINE_HEIGHT = 18;
+
+/// The logical width of the HUD.
+constexpr int HUD_WIDTH = 380;
+
+/// The distance of the HUD from the corner of the output and from its text.
+constexpr int HUD_MARGIN = 8;
+
+/// Format a line of the HUD.
+template <class... Args>
+static std::string format_line(const char *fmt, Args... args) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), fmt, args...);
+    return buf;
+}
+
+/// Convert a duration to fractional milliseconds.
+static double to_ms(PerfCounters::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::vector<std::string>
+PerfHud::format_sample(PerfCounters::Clock::duration elapsed) {
+    const auto &perf = swayfire->perf;
+    const double secs = std::max(to_ms(elapsed) / 1000.0, 0.001);
+
+    // Only views are configured or stretched.
+    std::vector<ViewNodeRef> views;
+    const auto collect = [&](Node n) {
+        if (auto view_node = n->as_view_node())
+            views.push_back(view_node);
+    };
+    swayfire->workspaces.for_each(
+        [&](WorkspaceRef ws) { ws->for_each_node(collect); });
+    for (const auto &sticky : swayfire->sticky.get_nodes())
+        sticky->for_each_node(collect);
+
+    const auto stretched = std::count_if(
+        views.begin(), views.end(), [](ViewNodeRef v) {
+            return !v->is_fullscreen() && v->geo_enforcer->is_stretching();
+        });
+
+    const double avg_layout =
+        perf.layout_passes ? to_ms(perf.layout_time) / perf.layout_passes : 0;
+
+    std::vector<std::string> text = {
+        format_line("layout: %u passes, avg %.2f ms, max %.2f ms",
+                    perf.layout_passes, avg_layout,
+                    to_ms(perf.max_layout_time)),
+        format_line("configures: %.1f/s", perf.configures / secs),
+        format_line("texture uploads: %.1f/s", perf.texture_uploads / secs),
+        format_line("deco draw calls: %.1f/s", perf.draw_calls / secs),
+        format_line("stretched views: %d", (int)stretched),
+        "slowest acks:",
+    };
+
+    const auto n_slowest = std::min(HUD_SLOWEST_CLIENTS, views.size());
+    std::partial_sort(views.begin(), views.begin() + n_slowest, views.end(),
+                      [](ViewNodeRef a, ViewNodeRef b) {
+                          return a->get_ack_latency() > b->get_ack_latency();
+                      });
+
+    for (std::size_t i = 0; i < n_slowest; i++) {
+        const auto latency = views[i]->get_ack_latency();
+        if (latency == PerfCounters::Clock::duration::zero())
+            break;
+
+        const std::string app_id = views[i]->view->get_app_id();
+        text.push_back(format_line("  %7.1f ms  %.40s", to_ms(latency),
+                                   app_id.c_str()));
+    }
+
+    return text;
+}
+
+void PerfHud::sample() {
+    const auto now = PerfCounters::Clock::now();
+    const auto text = format_sample(now - last_sample);
+    last_sample = now;
+    swayfire->perf.reset();
+
+    output->render->damage(geometry);
+
+    geometry = {
+        HUD_MARGIN,
+        HUD_MARGIN,
+        HUD_WIDTH,
+        (int)text.size() * HUD_LINE_HEIGHT + 2 * HUD_MARGIN,
+    };
+    lines.resize(text.size());
+
+    const float scale = output->handle->scale;
+
+    OpenGL::render_begin();
+    for (std::size_t i = 0; i < text.size(); i++)
+        lines[i].cache_texture({
+            {HUD_WIDTH - 2 * HUD_MARGIN, HUD_LINE_HEIGHT},
+            scale,
+            font,
+            text[i],
+            wf::color_t(1, 1, 1, 1),
+        });
+    OpenGL::render_end();
+
+    output->render->damage(geometry);
+    sample_timer.set_timeout(HUD_SAMPLE_INTERVAL, [&]() { sample(); });
+}
+
+void PerfHud::render() {
+    const auto fb = output->render->get_target_framebuffer();
+    const auto matrix = fb.get_orthographic_projection();
+
+    OpenGL::render_begin(fb);
+    OpenGL::render_rectangle(geometry, wf::color_t(0, 0, 0, 0.7), matrix);
+    for (std::size_t i = 0; i < lines.size(); i++)
+        lines[i].render({0, (int)i * HUD_LINE_HEIGHT},
+                        {geometry.x + HUD_MARGIN, geometry.y + HUD_MARGIN},
+                        matrix);
+    OpenGL::render_end();
+}
+
+void PerfHud::show() {
+    if (shown)
+        return;
+
+    shown = true;
+    swayfire->perf.enabled = true;
+    last_sample = PerfCounters::Clock::now();
+    swayfire->perf.reset();
+
+    output->render->add_effect(&on_overlay, wf::OUTPUT_EFFECT_OVERLAY);
+    sample();
+}
+
+void PerfHud::hide() {
+    if (!shown)
+        return;
+
+    shown = false;
+    swayfire->perf.enabled = false;
+    sample_timer.disconnect();
+
+    output->render->rem_effect(&on_overlay);
+    output->render->damage(geometry);
+
+    OpenGL::render_begin();
+    lines.clear();
+    OpenGL::render_end();
+}
+
+void PerfHud::toggle() {
+    if (shown)
+        hide();
+    else
+        show();
+}
@@ -0,0 +1,74 @@
+#ifndef SWAYFIRE_HUD_HPP
+#define SWAYFIRE_HUD_HPP
+#pragma once
+
+#include <string>
+#include <vector>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/util.hpp>
+
+#include "../core/core.hpp"
+#include "../core/plugin.hpp"
+#include "subsurf.hpp"
+
+/// On-screen display of the perf counters of an output.
+///
+/// The counters are only maintained while the HUD is shown. They are sampled
+/// and reset once per HUD_SAMPLE_INTERVAL, which is also the only time the
+/// text of the HUD is rasterized.
+class PerfHud {
+  private:
+    OutputRef output;
+    SwayfireRef swayfire;
+
+    /// The font to draw the HUD with.
+    std::string font;
+
+    /// Whether the HUD is shown.
+    bool shown = false;
+
+    /// The lines of text displayed, rasterized when sampled.
+    std::vector<TextSubSurf> lines;
+
+    /// The output-local geometry of the HUD.
+    wf::geometry_t geometry{0, 0, 0, 0};
+
+    /// The time of the last sample.
+    PerfCounters::Clock::time_point last_sample;
+
+    /// Fires at every sample.
+    wf::wl_timer<false> sample_timer;
+
+    /// Format the counters sampled over the given duration into lines.
+    [[nodiscard]] std::vector<std::string>
+    format_sample(PerfCounters::Clock::duration elapsed);
+
+    /// Sample and reset the counters, and rasterize the HUD.
+    void sample();
+
+    /// Render the HUD.
+    void render();
+
+    /// Render the HUD on top of the output.
+    wf::effect_hook_t on_overlay = [&]() { render(); };
+
+  public:
+    PerfHud(OutputRef output, SwayfireRef swayfire)
+        : output(output), swayfire(swayfire) {}
+
+    ~PerfHud() { hide(); }
+
+    /// Set the font to draw the HUD with.
+    void set_font(std::string nfont) { font = std::move(nfont); }
+
+    /// Show the HUD, enabling the perf counters.
+    void show();
+
+    /// Hide the HUD, disabling the perf counters.
+    void hide();
+
+    /// Show the HUD if hidden, else hide it.
+    void toggle();
+};
+
+#endif // ifndef SWAYFIRE_HUD_HPP
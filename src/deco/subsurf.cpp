@@ -1,5 +1,6 @@
 #include "subsurf.hpp"
 
+#include <cmath>
 #include <wayfire/opengl.hpp>
 #include <wayfire/plugins/common/cairo-util.hpp>
 
@@ -168,11 +169,33 @@ bool contains_point(Spec spec, wf::point_t pt) {
 
 // TextSubSurf
 
-void TextSubSurf::cache_texture(CachedSpec spec) {
+bool TextSubSurf::CacheKey::matches(const CachedSpec &spec) const {
+    return size.width == spec.size.width && size.height == spec.size.height &&
+           scale == spec.scale && font == spec.font && text == spec.text &&
+           color.r == spec.color.r && color.g == spec.color.g &&
+           color.b == spec.color.b && color.a == spec.color.a;
+}
+
+bool TextSubSurf::cache_texture(CachedSpec spec) {
+    if (cached_key && cached_key->matches(spec))
+        return false;
+
+    cached_key = CacheKey{
+        spec.size,
+        spec.scale,
+        std::string(spec.font),
+        std::string(spec.text),
+        spec.color,
+    };
+
+    // Rasterize at the buffer scale so text stays crisp on HiDPI outputs,
+    // while drawing in logical coordinates.
     constexpr auto format = CAIRO_FORMAT_ARGB32;
-    auto surface =
-        cairo_image_surface_create(format, spec.size.width, spec.size.height);
+    auto surface = cairo_image_surface_create(
+        format, (int)std::ceil((float)spec.size.width * spec.scale),
+        (int)std::ceil((float)spec.size.height * spec.scale));
     auto cr = cairo_create(surface);
+    cairo_scale(cr, spec.scale, spec.scale);
 
     constexpr float font_scale = 0.8;
     const float font_size = (float)spec.size.height * font_scale;
@@ -195,15 +218,20 @@ void TextSubSurf::cache_texture(CachedSpec spec) {
 
     cairo_surface_upload_to_texture(surface, texture);
     cairo_surface_destroy(surface);
+    return true;
 }
 
 void TextSubSurf::render(Spec spec, wf::point_t origin,
                          glm::mat4 matrix) const {
+    if (!cached_key)
+        return;
+
+    // The texture is displayed at its logical size.
     const wf::geometry_t geo = {
         spec.x + origin.x,
         spec.y + origin.y,
-        texture.width,
-        texture.height,
+        cached_key->size.width,
+        cached_key->size.height,
     };
 
     // TODO: see if we can instead set the color using this color multiplier
@@ -528,14 +556,17 @@ bool contains_point(Spec spec, wf::point_t pt) {
 
 // TitleBarSubSurf
 
-void TitleBarSubSurf::cache_textures(CachedSpec spec) {
+bool TitleBarSubSurf::cache_textures(CachedSpec spec) {
     auto size = wf::dimensions(spec.spec.geo);
     size.width -= (int)((double)size.height * 0.2);
 
-    title_text.cache_texture({
+    return title_text.cache_texture({
         // size
         size,
 
+        // scale
+        spec.scale,
+
         // font
         spec.font,
 
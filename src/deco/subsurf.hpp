@@ -2,6 +2,8 @@
 #define SWAYFIRE_SUBSURF_HPP
 
 #include <functional>
+#include <optional>
+#include <string>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <utility>
 #include <wayfire/config/types.hpp>
@@ -57,18 +59,37 @@ void render(Spec spec, wf::color_t color, wf::point_t origin, glm::mat4 matrix);
 /// Text subsurface.
 struct TextSubSurf {
     struct CachedSpec {
-        const wf::dimensions_t size; ///< Size of the text texture.
+        const wf::dimensions_t size; ///< Logical size of the text texture.
+        const float scale;           ///< Buffer scale to rasterize at.
         const std::string_view font; ///< Font to use to display the text.
         const std::string_view text; ///< Text content.
         const wf::color_t color;     ///< The text color.
     };
 
+    /// Owned copy of the CachedSpec the texture was rasterized from.
+    struct CacheKey {
+        wf::dimensions_t size;
+        float scale;
+        std::string font;
+        std::string text;
+        wf::color_t color;
+
+        /// Whether the key was made from the given spec.
+        [[nodiscard]] bool matches(const CachedSpec &spec) const;
+    };
+
     using Spec = wf::point_t; ///< Position where the text surface is drawn.
 
     wf::simple_texture_t texture; ///< The cached text texture.
 
-    /// Cache the text cairo texture.
-    void cache_texture(CachedSpec spec);
+    /// The key of the cached texture, if any.
+    std::optional<CacheKey> cached_key;
+
+    /// Cache the text cairo texture, rasterized at the spec's buffer scale.
+    ///
+    /// Does nothing if the cached texture was already made from the same spec.
+    /// Return whether a texture was uploaded.
+    bool cache_texture(CachedSpec spec);
 
     void render(Spec spec, wf::point_t origin, glm::mat4 matrix) const;
     [[nodiscard]] wf::region_t calculate_region(Spec spec) const;
@@ -106,6 +127,7 @@ struct TitleBarSubSurf {
 
     struct CachedSpec {
         const Spec spec;
+        const float scale;             ///< Buffer scale to rasterize at.
         const std::string_view font;   ///< Font to use to display the text.
         const std::string_view title;  ///< Title text content.
         const wf::color_t title_color; ///< The text color.
@@ -118,8 +140,8 @@ struct TitleBarSubSurf {
 
     TextSubSurf title_text;
 
-    /// Cache the cairo textures.
-    void cache_textures(CachedSpec spec);
+    /// Cache the cairo textures. Return whether a texture was uploaded.
+    bool cache_textures(CachedSpec spec);
 
     static SubSpecs get_subspecs(Spec spec);
 
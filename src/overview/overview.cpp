@@ -0,0 +1,293 @@
+#include "overview.hpp"
+
+#include <linux/input-event-codes.h>
+#include <wayfire/nonstd/wlroots-full.hpp>
+#include <wayfire/opengl.hpp>
+
+#include "../core/grab.hpp"
+
+// SwayfireOverview
+
+constexpr int ACTIVE_BORDER_WIDTH = 3;
+
+Thumbnail &SwayfireOverview::get_thumbnail(wf::point_t wsid) {
+    return thumbnails.at(wsid.x * grid.height + wsid.y);
+}
+
+wf::geometry_t SwayfireOverview::get_thumbnail_geometry(wf::point_t wsid) {
+    const auto og = output->get_relative_geometry();
+    const int spacing = options.spacing;
+
+    const int cell_w = (og.width - spacing) / grid.width;
+    const int cell_h = (og.height - spacing) / grid.height;
+
+    const int w = (int)((float)og.width * scale);
+    const int h = (int)((float)og.height * scale);
+
+    return {
+        spacing + wsid.x * cell_w + (cell_w - spacing - w) / 2,
+        spacing + wsid.y * cell_h + (cell_h - spacing - h) / 2,
+        w,
+        h,
+    };
+}
+
+void SwayfireOverview::update_layout() {
+    const auto ngrid = output->workspace->get_workspace_grid_size();
+    const auto og = output->get_relative_geometry();
+    const int spacing = options.spacing;
+
+    const int cell_w = (og.width - spacing) / ngrid.width - spacing;
+    const int cell_h = (og.height - spacing) / ngrid.height - spacing;
+    const float nscale =
+        std::max(0.01f, std::min((float)cell_w / (float)og.width,
+                                 (float)cell_h / (float)og.height));
+
+    if (ngrid.width == grid.width && ngrid.height == grid.height &&
+        nscale == scale)
+        return;
+
+    clear_thumbnails();
+
+    grid = ngrid;
+    scale = nscale;
+    thumbnails.resize(grid.width * grid.height);
+
+    for (int x = 0; x < grid.width; x++) {
+        for (int y = 0; y < grid.height; y++) {
+            auto &thumb = get_thumbnail({x, y});
+            thumb.stream.ws = {x, y};
+            thumb.stream.background = options.background;
+        }
+    }
+}
+
+void SwayfireOverview::clear_thumbnails() {
+    for (auto &thumb : thumbnails)
+        if (thumb.started)
+            output->render->workspace_stream_stop(thumb.stream);
+
+    thumbnails.clear();
+    next_update = 0;
+}
+
+void SwayfireOverview::update_thumbnails(std::size_t budget) {
+    // Streams only re-render the areas of their workspace that were damaged
+    // since their last update. Still, cap the amount of streams updated per
+    // frame so that a burst of changes fits in a frame.
+    bool pending = false;
+    for (std::size_t i = 0; i < thumbnails.size(); i++) {
+        auto &thumb = thumbnails.at(next_update);
+        next_update = (next_update + 1) % thumbnails.size();
+
+        if (!thumb.damaged)
+            continue;
+
+        if (budget == 0) {
+            pending = true;
+            break;
+        }
+        budget--;
+
+        // Apply the layout deferred while the workspace was not visible.
+        swayfire->workspaces.get(thumb.stream.ws)->flush_pending_layout();
+
+        output->render->workspace_stream_update(thumb.stream, scale, scale);
+        thumb.ready = true;
+        thumb.damaged = false;
+
+        output->render->damage(get_thumbnail_geometry(thumb.stream.ws));
+    }
+
+    if (pending)
+        output->render->schedule_redraw();
+}
+
+void SwayfireOverview::damage_workspace(wf::point_t wsid) {
+    if (wsid.x < 0 || wsid.y < 0 || wsid.x >= grid.width ||
+        wsid.y >= grid.height)
+        return;
+
+    get_thumbnail(wsid).damaged = true;
+    output->render->schedule_redraw();
+}
+
+void SwayfireOverview::watch_node(ViewNodeRef node) {
+    auto watch = std::make_unique<ViewWatch>();
+    const auto raw = watch.get();
+    const auto damage_node = [this, node]() {
+        damage_workspace(node->get_ws()->wsid);
+    };
+
+    raw->on_commit.set_callback([=](void *) { damage_node(); });
+    if (const auto surface = node->view->get_wlr_surface())
+        raw->on_commit.connect(&surface->events.commit);
+
+    raw->on_geometry_changed.set_callback(
+        [=](GeometryChangedSignalData *) { damage_node(); });
+    node->connect(&raw->on_geometry_changed);
+
+    raw->on_detached.set_callback([=](DetachedSignalData *) {
+        damage_node();
+        raw->on_commit.disconnect();
+    });
+    node->connect(&raw->on_detached);
+
+    watches.push_back(std::move(watch));
+}
+
+void SwayfireOverview::unwatch_nodes() { watches.clear(); }
+
+void SwayfireOverview::render() {
+    const auto fb = output->render->get_target_framebuffer();
+    const auto matrix = fb.get_orthographic_projection();
+    const auto curr_wsid = output->workspace->get_current_workspace();
+
+    OpenGL::render_begin(fb);
+    OpenGL::render_rectangle(output->get_relative_geometry(),
+                             options.background, matrix);
+
+    for (int x = 0; x < grid.width; x++) {
+        for (int y = 0; y < grid.height; y++) {
+            const auto &thumb = get_thumbnail({x, y});
+            const auto geo = get_thumbnail_geometry({x, y});
+
+            if (x == curr_wsid.x && y == curr_wsid.y) {
+                const int bw = ACTIVE_BORDER_WIDTH;
+                OpenGL::render_rectangle(
+                    {geo.x - bw, geo.y - bw, geo.width + 2 * bw,
+                     geo.height + 2 * bw},
+                    options.active_border, matrix);
+            }
+
+            if (thumb.ready)
+                OpenGL::render_transformed_texture(
+                    thumb.stream.buffer.tex, geo, matrix, glm::vec4(1),
+                    OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
+        }
+    }
+    OpenGL::render_end();
+}
+
+bool SwayfireOverview::activate() {
+    if (!output->activate_plugin(grab_interface))
+        return false;
+
+    if (!grab_interface->grab()) {
+        output->deactivate_plugin(grab_interface);
+        return false;
+    }
+
+    update_layout();
+
+    // Changes made while hidden weren't tracked: bring every stream up to
+    // date on the first frame so that no thumbnail shows up blank or stale.
+    for (auto &thumb : thumbnails) {
+        if (!thumb.started) {
+            output->render->workspace_stream_start(thumb.stream);
+            thumb.started = true;
+        }
+        thumb.damaged = true;
+    }
+    update_all = true;
+
+    const auto watch = [&](Node n) {
+        if (auto view_node = n->as_view_node())
+            watch_node(view_node);
+    };
+    swayfire->workspaces.for_each(
+        [&](WorkspaceRef ws) { ws->for_each_node(watch); });
+    for (const auto &node : swayfire->sticky.get_nodes())
+        node->for_each_node(watch);
+
+    output->connect(&on_view_node_attached);
+    output->connect(&on_view_change_workspace);
+
+    active = true;
+    output->render->add_effect(&on_pre_frame, wf::OUTPUT_EFFECT_PRE);
+    output->render->add_effect(&on_overlay, wf::OUTPUT_EFFECT_OVERLAY);
+    output->render->damage_whole();
+
+    return true;
+}
+
+void SwayfireOverview::deactivate() {
+    if (!active)
+        return;
+
+    active = false;
+    output->disconnect(&on_view_change_workspace);
+    output->disconnect(&on_view_node_attached);
+    unwatch_nodes();
+
+    output->render->rem_effect(&on_overlay);
+    output->render->rem_effect(&on_pre_frame);
+    output->render->damage_whole();
+
+    grab_interface->ungrab();
+    output->deactivate_plugin(grab_interface);
+}
+
+void SwayfireOverview::focus_at(wf::point_t p) {
+    for (int x = 0; x < grid.width; x++) {
+        for (int y = 0; y < grid.height; y++) {
+            const auto geo = get_thumbnail_geometry({x, y});
+            if (!(geo & p))
+                continue;
+
+            auto ws = swayfire->workspaces.get({x, y});
+            const wf::point_t local = {
+                (int)((float)(p.x - geo.x) / scale),
+                (int)((float)(p.y - geo.y) / scale),
+            };
+
+            // Floating nodes are drawn above tiled nodes.
+            Node target = nullptr;
+            for (auto &floating : ws->floating_nodes)
+                floating.node->for_each_node([&](Node n) {
+                    if (n->as_view_node() && (n->get_geometry() & local))
+                        target = n;
+                });
+
+            if (!target)
+                if (auto leaf = LeafGrid(ws, nullptr).at(local))
+                    ws->for_each_node([&](Node n) {
+                        if (n->as_view_node() && n->get_id() == leaf->node_id)
+                            target = n;
+                    });
+
+            output->workspace->request_workspace({x, y});
+            if (target)
+                target->set_active();
+
+            return;
+        }
+    }
+}
+
+void SwayfireOverview::swf_init() {
+    grab_interface->name = "swayfire-overview";
+    grab_interface->capabilities =
+        wf::CAPABILITY_GRAB_INPUT | wf::CAPABILITY_MANAGE_DESKTOP;
+
+    grab_interface->callbacks.pointer.button = [&](std::uint32_t b,
+                                                   std::uint32_t state) {
+        if (b != BTN_LEFT || state != WLR_BUTTON_RELEASED)
+            return;
+
+        // Thumbnails are laid out in output-local coordinates.
+        auto p = output->get_cursor_position();
+        focus_at({(int)p.x, (int)p.y});
+        deactivate();
+    };
+
+    output->add_activator(options.toggle, &on_toggle);
+}
+
+void SwayfireOverview::swf_fini() {
+    deactivate();
+    output->rem_binding(&on_toggle);
+    clear_thumbnails();
+}
+
+DECLARE_WAYFIRE_PLUGIN(wf::per_output_plugin_t<SwayfireOverview>)
@@ -0,0 +1,162 @@
+#ifndef SWAYFIRE_OVERVIEW_HPP
+#define SWAYFIRE_OVERVIEW_HPP
+#pragma once
+
+#include <utility>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/plugin.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/util.hpp>
+
+#include "../core/core.hpp"
+#include "../core/plugin.hpp"
+
+struct OverviewOptions {
+    wf::option_wrapper_t<wf::activatorbinding_t> toggle{
+        "swayfire-overview/toggle"};
+    wf::option_wrapper_t<int> spacing{"swayfire-overview/spacing"};
+    wf::option_wrapper_t<int> updates_per_frame{
+        "swayfire-overview/updates_per_frame"};
+    wf::option_wrapper_t<wf::color_t> background{
+        "swayfire-overview/background"};
+    wf::option_wrapper_t<wf::color_t> active_border{
+        "swayfire-overview/active_border"};
+};
+
+/// A cached downscaled rendering of a workspace.
+struct Thumbnail {
+    /// The stream rendering the workspace into a texture.
+    wf::workspace_stream_t stream;
+
+    /// Whether the stream was started.
+    bool started = false;
+
+    /// Whether the stream was rendered at least once at the current scale.
+    bool ready = false;
+
+    /// Whether the workspace changed since the stream was last updated.
+    bool damaged = true;
+};
+
+/// Watches a view node for changes of the workspace it is shown on.
+struct ViewWatch {
+    /// Fires when the client commits a new buffer.
+    wf::wl_listener_wrapper on_commit;
+
+    /// Fires when the node is laid out somewhere else.
+    wf::signal::connection_t<GeometryChangedSignalData> on_geometry_changed;
+
+    /// Fires when the node is destroyed.
+    wf::signal::connection_t<DetachedSignalData> on_detached;
+};
+
+/// Exposé-style overview of all the workspaces of the output.
+///
+/// Workspaces are rendered into streams at the scale they are displayed at.
+/// Streams are kept alive between openings and only re-render their damaged
+/// areas. While shown, the views are watched so that only the streams of the
+/// workspaces that changed get updated, a few of them per frame.
+class SwayfireOverview final : public SwayfirePlugin {
+  private:
+    OverviewOptions options{};
+
+    /// Whether the overview is shown.
+    bool active = false;
+
+    /// The dimensions of the workspace grid the thumbnails were laid out for.
+    wf::dimensions_t grid{0, 0};
+
+    /// The thumbnails of the workspaces: thumbnails[x * grid.height + y].
+    std::vector<Thumbnail> thumbnails;
+
+    /// The scale the thumbnails are rendered and displayed at.
+    float scale = 1.0;
+
+    /// The index of the next thumbnail to update.
+    std::size_t next_update = 0;
+
+    /// Whether all the damaged thumbnails are updated next frame, whatever
+    /// the per-frame budget.
+    bool update_all = false;
+
+    /// The watches of the view nodes of the output while shown.
+    std::vector<std::unique_ptr<ViewWatch>> watches;
+
+    /// Get the thumbnail of a workspace.
+    Thumbnail &get_thumbnail(wf::point_t wsid);
+
+    /// Get the output-local geometry at which a workspace is displayed.
+    [[nodiscard]] wf::geometry_t get_thumbnail_geometry(wf::point_t wsid);
+
+    /// Recompute the layout of the thumbnails, dropping outdated ones.
+    void update_layout();
+
+    /// Stop all the streams and drop all thumbnails.
+    void clear_thumbnails();
+
+    /// Update the damaged thumbnails, at most budget of them.
+    void update_thumbnails(std::size_t budget);
+
+    /// Note that a workspace changed, updating its thumbnail next frame.
+    void damage_workspace(wf::point_t wsid);
+
+    /// Start watching a view node for changes.
+    void watch_node(ViewNodeRef node);
+
+    /// Stop watching all the view nodes.
+    void unwatch_nodes();
+
+    /// Render the overview.
+    void render();
+
+    /// Show the overview.
+    bool activate();
+
+    /// Hide the overview.
+    void deactivate();
+
+    /// Focus the workspace and node under the given output-local point.
+    void focus_at(wf::point_t p);
+
+    /// Update thumbnails before the frame is rendered.
+    wf::effect_hook_t on_pre_frame = [&]() {
+        const auto budget =
+            std::exchange(update_all, false)
+                ? thumbnails.size()
+                : (std::size_t)std::max(1, (int)options.updates_per_frame);
+        update_thumbnails(budget);
+    };
+
+    /// Watch the views attached while shown.
+    wf::signal::connection_t<ViewNodeSignalData> on_view_node_attached =
+        [&](ViewNodeSignalData *data) {
+            watch_node(data->node);
+            damage_workspace(data->node->get_ws()->wsid);
+        };
+
+    /// Update both workspaces of views moved between workspaces.
+    wf::signal::connection_t<wf::view_change_workspace_signal>
+        on_view_change_workspace = [&](wf::view_change_workspace_signal *data) {
+            if (data->old_workspace_valid)
+                damage_workspace(data->from);
+            damage_workspace(data->to);
+        };
+
+    /// Render the overview on top of the output.
+    wf::effect_hook_t on_overlay = [&]() { render(); };
+
+    wf::activator_callback on_toggle = [&](auto) {
+        if (active) {
+            deactivate();
+            return true;
+        }
+        return activate();
+    };
+
+  public:
+    // == Impl SwayfirePlugin ==
+    void swf_init() override;
+    void swf_fini() override;
+};
+
+#endif // ifndef SWAYFIRE_OVERVIEW_HPP